@@ -0,0 +1,82 @@
+#include "AsyncLoader.h"
+
+AsyncLoader::~AsyncLoader() {
+	wait();
+}
+
+//  add:  returns the job's id, for use in a later job's "after" list.
+//        "weight" is its share of the progress bar.
+//
+int AsyncLoader::add(const string & name, float weight, std::function<bool()> job, const vector<int> & after) {
+	Job j;
+	j.name = name;
+	j.weight = weight;
+	j.run = job;
+	j.after = after;
+	jobs.push_back(j);
+	return jobs.size() - 1;
+}
+
+// one thread per job; a job's thread sleeps until its dependencies are done
+//
+void AsyncLoader::start() {
+	for (int i = 0; i < jobs.size(); i++) threads.push_back(std::thread(&AsyncLoader::runJob, this, i));
+}
+
+void AsyncLoader::wait() {
+	for (auto & t : threads) {
+		if (t.joinable()) t.join();
+	}
+	threads.clear();
+}
+
+void AsyncLoader::runJob(int i) {
+	Job & job = jobs[i];
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		jobDone.wait(guard, [&] {
+			for (int k : job.after) {
+				if (!jobs[k].done) return false;
+			}
+			return true;
+		});
+		job.running = true;
+	}
+
+	// a failed dependency fails everything after it without running
+	//
+	bool skip = bFailed;
+	bool ok = skip || job.run();
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		job.running = false;
+		job.done = true;
+	}
+	if (!ok) {
+		bFailed = true;
+		cout << "Error: loading failed at \"" << job.name << "\"" << endl;
+	}
+	numDone++;
+	jobDone.notify_all();
+}
+
+float AsyncLoader::progress() const {
+	std::lock_guard<std::mutex> guard(lock);
+	float total = 0, done = 0;
+	for (const Job & j : jobs) {
+		total += j.weight;
+		if (j.done) done += j.weight;
+	}
+	return total > 0 ? done / total : 1;
+}
+
+string AsyncLoader::status() const {
+	std::lock_guard<std::mutex> guard(lock);
+	string s;
+	for (const Job & j : jobs) {
+		if (!j.running) continue;
+		if (!s.empty()) s += ", ";
+		s += j.name;
+	}
+	return s;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//  Startup work run on background threads.
+//
+//  Each job is a function that returns false on failure, plus the jobs that
+//  must finish before it starts; independent jobs run at the same time.
+//  The main thread polls finished() / progress() / status() each frame and
+//  picks the results up once everything is done.  Jobs must not touch GL.
+//
+class AsyncLoader {
+public:
+	~AsyncLoader();
+
+	int add(const string & name, float weight, std::function<bool()> job, const vector<int> & after = vector<int>());
+	void start();
+	void wait();
+
+	bool finished() const { return numDone == jobs.size(); }
+	bool failed() const { return bFailed; }
+	float progress() const;		// 0..1, by job weight
+	string status() const;		// names of the jobs running now
+
+private:
+	struct Job {
+		string name;
+		float weight;
+		std::function<bool()> run;
+		vector<int> after;
+		bool running = false;
+		bool done = false;
+	};
+
+	void runJob(int i);
+
+	vector<Job> jobs;
+	vector<std::thread> threads;
+	mutable std::mutex lock;
+	std::condition_variable jobDone;
+	std::atomic<int> numDone { 0 };
+	std::atomic<bool> bFailed { false };
+};
@@ -0,0 +1,624 @@
+#include "Benchmark.h"
+#include "Emitter.h"
+#include "ObjLoader.h"
+#include "ofxAssimpModelLoader.h"
+#include <thread>
+
+void benchOctreeDescent(Octree & octree, const glm::vec3 & landerMin, const glm::vec3 & landerMax,
+	const glm::vec3 & start, int frames) {
+	float bottom = octree.root.box.min().y();
+	OctreeCursor rootCursor, boxCursor, rayCursor;
+	long rootBoxNodes = 0, boxNodes = 0, rayNodes = 0;
+	int maxBoxNodes = 0, maxRayNodes = 0;
+	int mismatches = 0;
+	vector<Box> rootHits, hits;
+
+	for (int i = 0; i < frames; i++) {
+
+		// slow drift sideways while descending, like a typical approach
+		//
+		float t = (float)i / frames;
+		glm::vec3 p = start + glm::vec3(5 * t, (bottom - start.y) * t, -3 * t);
+		glm::vec3 min = landerMin + p;
+		glm::vec3 max = landerMax + p;
+		Box bounds = Box(min, max);
+		Ray downRay = Ray(p, Vector3(0, -1, 0));
+
+		// a cursor reset every frame behaves like a query from the root
+		//
+		rootCursor.reset();
+		rootHits.clear();
+		octree.intersect(bounds, rootCursor, rootHits);
+		rootBoxNodes += rootCursor.nodesVisited;
+
+		hits.clear();
+		octree.intersect(bounds, boxCursor, hits);
+		boxNodes += boxCursor.nodesVisited;
+		maxBoxNodes = std::max(maxBoxNodes, boxCursor.nodesVisited);
+		octree.intersect(downRay, rayCursor);
+		rayNodes += rayCursor.nodesVisited;
+		maxRayNodes = std::max(maxRayNodes, rayCursor.nodesVisited);
+
+		if (hits.size() != rootHits.size()) mismatches++;
+	}
+
+	cout << "octree descent (" << frames << " frames)" << endl;
+	cout << "  box query nodes/frame: root " << (float)rootBoxNodes / frames
+		<< "  cursor " << (float)boxNodes / frames << " (max " << maxBoxNodes << ")" << endl;
+	cout << "  ray query nodes/frame: " << (float)rayNodes / frames << " (max " << maxRayNodes << ")" << endl;
+	cout << "  box results differing from root query: " << mismatches << endl;
+}
+
+void benchOctreeNearest(const Octree & octree, int queries, int k, float radius) {
+	// the tree indexes welded points, so brute force scans those too
+	//
+	const ofMesh & mesh = octree.mesh;
+	const vector<int> & unique = octree.weldUnique;
+	int n = unique.size();
+	if (n == 0) return;
+	Box b = octree.root.box;
+	vector<glm::vec3> points(queries);
+	for (int i = 0; i < queries; i++) {
+		points[i] = glm::vec3(ofRandom(b.min().x(), b.max().x()), ofRandom(b.min().y(), b.max().y()),
+			ofRandom(b.min().z(), b.max().z()));
+	}
+
+	OctreeQueryScratch scratch;
+	vector<PointHit> hits;
+	vector<vector<PointHit>> treeKnn(queries), treeRadius(queries);
+
+	uint64_t start = ofGetElapsedTimeMicros();
+	for (int i = 0; i < queries; i++) {
+		octree.nearest(points[i], k, scratch, hits);
+		treeKnn[i] = hits;
+	}
+	uint64_t knnTime = ofGetElapsedTimeMicros() - start;
+
+	start = ofGetElapsedTimeMicros();
+	for (int i = 0; i < queries; i++) {
+		octree.withinRadius(points[i], radius, scratch, hits);
+		treeRadius[i] = hits;
+	}
+	uint64_t radiusTime = ofGetElapsedTimeMicros() - start;
+
+	// brute force: distance to every vertex, then partial sort / filter
+	//
+	vector<PointHit> all(n);
+	int knnMismatch = 0, radiusMismatch = 0;
+	uint64_t bruteKnnTime = 0, bruteRadiusTime = 0;
+	for (int i = 0; i < queries; i++) {
+		start = ofGetElapsedTimeMicros();
+		for (int j = 0; j < n; j++) all[j] = make_pair(unique[j], glm::distance2(mesh.getVertex(unique[j]), points[i]));
+		int m = std::min(k, n);
+		partial_sort(all.begin(), all.begin() + m, all.end(),
+			[](const PointHit & a, const PointHit & c) { return a.second < c.second; });
+		bruteKnnTime += ofGetElapsedTimeMicros() - start;
+
+		// ties may pick different indices, so compare the k-th distance
+		//
+		if (treeKnn[i].size() != m || (m > 0 && treeKnn[i][m - 1].second != all[m - 1].second)) knnMismatch++;
+
+		start = ofGetElapsedTimeMicros();
+		int count = 0;
+		for (int j = 0; j < n; j++) {
+			if (glm::distance2(mesh.getVertex(unique[j]), points[i]) <= radius * radius) count++;
+		}
+		bruteRadiusTime += ofGetElapsedTimeMicros() - start;
+		if (count != treeRadius[i].size()) radiusMismatch++;
+	}
+
+	cout << "octree proximity (" << queries << " queries, " << n << " points)" << endl;
+	cout << "  knn k=" << k << ":  octree " << (float)knnTime / queries << " us/query"
+		<< "  brute force " << (float)bruteKnnTime / queries << " us/query"
+		<< "  mismatches " << knnMismatch << endl;
+	cout << "  radius " << radius << ":  octree " << (float)radiusTime / queries << " us/query"
+		<< "  brute force " << (float)bruteRadiusTime / queries << " us/query"
+		<< "  mismatches " << radiusMismatch << endl;
+}
+
+void benchLooseOctree(int count, int frames) {
+	const float world = 1000;
+	LooseOctree tree;
+	tree.setup(Box(Vector3(0, 0, 0), Vector3(world, world, world)));
+
+	vector<glm::vec3> pos(count), vel(count);
+	vector<float> half(count);
+	vector<int> handles(count);
+	for (int i = 0; i < count; i++) {
+		pos[i] = glm::vec3(ofRandom(world), ofRandom(world), ofRandom(world));
+		vel[i] = glm::vec3(ofRandom(-2, 2), ofRandom(-2, 2), ofRandom(-2, 2));
+		half[i] = ofRandom(0.25, 2);
+		glm::vec3 h(half[i]);
+		glm::vec3 lo = pos[i] - h, hi = pos[i] + h;
+		handles[i] = tree.insert(Box(lo, hi), i);
+	}
+
+	vector<pair<int, int>> pairs;
+	pairs.reserve(count * 4);
+	uint64_t updateTime = 0, pairTime = 0;
+	long totalPairs = 0;
+	int bruteMismatch = -1;
+	for (int f = 0; f < frames; f++) {
+		uint64_t start = ofGetElapsedTimeMicros();
+		for (int i = 0; i < count; i++) {
+			pos[i] += vel[i];
+			for (int a = 0; a < 3; a++) {
+				if (pos[i][a] < 0 || pos[i][a] > world) vel[i][a] = -vel[i][a];
+			}
+			glm::vec3 h(half[i]);
+			glm::vec3 lo = pos[i] - h, hi = pos[i] + h;
+			tree.update(handles[i], Box(lo, hi));
+		}
+		updateTime += ofGetElapsedTimeMicros() - start;
+
+		start = ofGetElapsedTimeMicros();
+		pairs.clear();
+		tree.pairs(pairs);
+		pairTime += ofGetElapsedTimeMicros() - start;
+		totalPairs += pairs.size();
+
+		if (f == 0) {
+			int brute = 0;
+			for (int i = 0; i < count; i++) {
+				for (int j = i + 1; j < count; j++) {
+					if (tree.bounds(handles[i]).overlap(tree.bounds(handles[j]))) brute++;
+				}
+			}
+			bruteMismatch = brute - (int)pairs.size();
+		}
+	}
+
+	cout << "loose octree (" << count << " moving boxes, " << frames << " frames)" << endl;
+	cout << "  update " << (float)updateTime / frames << " us/frame ("
+		<< (float)updateTime * 1000 / ((float)frames * count) << " ns/object)" << endl;
+	cout << "  pairs " << (float)pairTime / frames << " us/frame, "
+		<< (float)totalPairs / frames << " pairs/frame" << endl;
+	cout << "  pair count vs all-pairs test: " << bruteMismatch << endl;
+}
+
+void benchParticleCollision(const HeightField & ground, int count, int frames) {
+	if (!ground.isBaked()) return;
+	ParticleList list;
+	float x0 = ground.origin.x, z0 = ground.origin.z;
+	float x1 = x0 + (ground.width - 1) * ground.cellSize;
+	float z1 = z0 + (ground.depth - 1) * ground.cellSize;
+	for (int i = 0; i < count; i++) {
+		Particle p;
+		p.pos = glm::vec3(ofRandom(x0, x1), 0, ofRandom(z0, z1));
+		p.pos.y = ground.heightAt(p.pos.x, p.pos.z) + ofRandom(0, 5);
+		p.velocity = glm::vec3(ofRandom(-30, 30), ofRandom(-300, 0), ofRandom(-30, 30));
+		list.add(p);
+	}
+
+	uint64_t total = 0, worst = 0;
+	int overBudget = 0;
+	for (int f = 0; f < frames; f++) {
+		for (int i = 0; i < count; i++) {
+			list.particles[i].velocity.y -= 9.8 / 60;
+			list.particles[i].pos += list.particles[i].velocity / 60;
+		}
+		uint64_t start = ofGetElapsedTimeMicros();
+		list.collide(ground);
+		uint64_t t = ofGetElapsedTimeMicros() - start;
+		total += t;
+		worst = std::max(worst, t);
+		if (t > list.collideBudgetMicros) overBudget++;
+	}
+	cout << "particle collision (" << count << " particles, " << frames << " frames)" << endl;
+	cout << "  " << (float)total / frames << " us/frame avg, " << worst << " us worst, budget "
+		<< list.collideBudgetMicros << " us, " << overBudget << " frames over" << endl;
+}
+
+void benchObjLoad(const string & path) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	ofMesh mesh;
+	bool ok = ObjLoader::load(ofToDataPath(path), mesh);
+	uint64_t objTime = ofGetElapsedTimeMicros() - start;
+	start = ofGetElapsedTimeMicros();
+	ObjLoader::computeNormals(mesh);
+	uint64_t normalTime = ofGetElapsedTimeMicros() - start;
+
+	start = ofGetElapsedTimeMicros();
+	ofxAssimpModelLoader model;
+	bool assimpOk = model.loadModel(path);
+	ofMesh assimpMesh;
+	if (assimpOk) assimpMesh = model.getMesh(0);
+	uint64_t assimpTime = ofGetElapsedTimeMicros() - start;
+
+	cout << "obj load " << path << endl;
+	cout << "  ObjLoader: " << (ok ? "" : "FAILED ") << objTime / 1000.0 << " ms + normals " << normalTime / 1000.0
+		<< " ms, " << mesh.getNumVertices() << " vertices, " << mesh.getNumIndices() / 3 << " triangles" << endl;
+	cout << "  assimp:    " << (assimpOk ? "" : "FAILED ") << assimpTime / 1000.0 << " ms, "
+		<< assimpMesh.getNumVertices() << " vertices, " << assimpMesh.getNumIndices() / 3 << " triangles" << endl;
+}
+
+void benchOctreeBuild(const ofMesh & mesh, int numLevels) {
+	const int leafSizes[] = { 1, 4, 8, 16 };
+	const int queries = 2000;
+	cout << "octree build (" << mesh.getNumVertices() << " vertices, " << numLevels << " levels)" << endl;
+	vector<vector<int>> reference(queries);		// leafSize 1 points in each box
+	for (int leafSize : leafSizes) {
+		Octree octree;
+		octree.leafSize = leafSize;
+		uint64_t start = ofGetElapsedTimeMicros();
+		octree.create(mesh, numLevels);
+		uint64_t buildTime = ofGetElapsedTimeMicros() - start;
+
+		Box b = octree.root.box;
+		TreeNode hitNode;
+		vector<Box> hits;
+		int rayHits = 0;
+		long boxHits = 0;
+		start = ofGetElapsedTimeMicros();
+		for (int i = 0; i < queries; i++) {
+			float x = b.min().x() + (b.max().x() - b.min().x()) * (i * 0.618034f - floor(i * 0.618034f));
+			float z = b.min().z() + (b.max().z() - b.min().z()) * ((float)i / queries);
+			Ray ray(Vector3(x, b.max().y() + 10, z), Vector3(0, -1, 0));
+			if (octree.intersect(ray, octree.root, hitNode)) {
+				octree.closestPoint(hitNode, ray);
+				rayHits++;
+			}
+		}
+		uint64_t rayTime = ofGetElapsedTimeMicros() - start;
+		start = ofGetElapsedTimeMicros();
+		for (int i = 0; i < queries; i++) {
+			float x = b.min().x() + (b.max().x() - b.min().x()) * ((float)i / queries);
+			float z = b.min().z() + (b.max().z() - b.min().z()) * (i * 0.618034f - floor(i * 0.618034f));
+			Box q(Vector3(x - 1, b.min().y(), z - 1), Vector3(x + 1, b.max().y(), z + 1));
+			hits.clear();
+			octree.intersect(q, octree.root, hits);
+			boxHits += hits.size();
+		}
+		uint64_t boxTime = ofGetElapsedTimeMicros() - start;
+
+		// points in the same boxes; every leaf size must find the same points
+		//
+		OctreeQueryScratch scratch;
+		vector<int> points;
+		long pointHits = 0;
+		int mismatches = 0;
+		uint64_t pointsTime = 0;
+		for (int i = 0; i < queries; i++) {
+			float x = b.min().x() + (b.max().x() - b.min().x()) * ((float)i / queries);
+			float z = b.min().z() + (b.max().z() - b.min().z()) * (i * 0.618034f - floor(i * 0.618034f));
+			Box q(Vector3(x - 1, b.min().y(), z - 1), Vector3(x + 1, b.max().y(), z + 1));
+			start = ofGetElapsedTimeMicros();
+			octree.pointsInBox(q, scratch, points);
+			pointsTime += ofGetElapsedTimeMicros() - start;
+			pointHits += points.size();
+			if (leafSize == leafSizes[0]) reference[i] = points;
+			else if (points != reference[i]) mismatches++;
+		}
+
+		cout << "  leafSize " << leafSize << ": " << Octree::countNodes(octree.root) << " nodes, build "
+			<< buildTime / 1000 << " ms, ray " << (float)rayTime / queries << " us (" << rayHits << " hits), box "
+			<< (float)boxTime / queries << " us (" << (float)boxHits / queries << " leaves), points in box "
+			<< (float)pointsTime / queries << " us (" << (float)pointHits / queries << " points, "
+			<< mismatches << " differ from leafSize " << leafSizes[0] << ")" << endl;
+	}
+}
+
+void benchCompactOctree(Octree & octree, int queries) {
+	CompactOctree compact;
+	compact.build(octree, true);
+	int octreeNodes = Octree::countNodes(octree.root);
+
+	Box b = octree.root.box;
+	TreeNode hitNode;
+	vector<Box> hits, compactHits;
+	uint64_t rayTime = 0, compactRayTime = 0, boxTime = 0, compactBoxTime = 0;
+	int rayMismatch = 0, boxMismatch = 0;
+	float maxError = 0;
+	for (int i = 0; i < queries; i++) {
+		float x = b.min().x() + (b.max().x() - b.min().x()) * (i * 0.618034f - floor(i * 0.618034f));
+		float z = b.min().z() + (b.max().z() - b.min().z()) * ((float)i / queries);
+		Ray ray(Vector3(x, b.max().y() + 10, z), Vector3(0, -1, 0));
+		uint64_t start = ofGetElapsedTimeMicros();
+		int id = -1;
+		if (octree.intersect(ray, octree.root, hitNode)) id = octree.closestPoint(hitNode, ray);
+		rayTime += ofGetElapsedTimeMicros() - start;
+
+		start = ofGetElapsedTimeMicros();
+		glm::vec3 p;
+		int compactId = -1;
+		compact.intersect(ray, p, compactId);
+		compactRayTime += ofGetElapsedTimeMicros() - start;
+		if (id != compactId) rayMismatch++;
+		else if (id != -1) maxError = std::max(maxError, glm::distance(p, octree.mesh.getVertex(id)));
+
+		Box q(Vector3(z - 1, b.min().y(), x - 1), Vector3(z + 1, b.max().y(), x + 1));
+		hits.clear();
+		compactHits.clear();
+		start = ofGetElapsedTimeMicros();
+		octree.intersect(q, octree.root, hits);
+		boxTime += ofGetElapsedTimeMicros() - start;
+		start = ofGetElapsedTimeMicros();
+		compact.intersect(q, compactHits);
+		compactBoxTime += ofGetElapsedTimeMicros() - start;
+		if (hits.size() != compactHits.size()) boxMismatch++;
+	}
+
+	size_t octreeBytes = octree.memoryUsage();
+	size_t compactBytes = compact.memoryUsage();
+	cout << "compact octree (" << compact.numNodes() << " nodes, " << compact.numPoints() << " points, build "
+		<< compact.buildMicros / 1000 << " ms)" << endl;
+	cout << "  memory:  octree " << octreeBytes / 1024 << " KB (" << (float)octreeBytes / octreeNodes
+		<< " bytes/node incl. mesh), compact " << compactBytes / 1024 << " KB ("
+		<< (float)compact.nodeMemory() / compact.numNodes() << " bytes/node, "
+		<< (float)(compactBytes - compact.nodeMemory()) / compact.numPoints() << " bytes/point with ids)" << endl;
+	cout << "  ray:     octree " << (float)rayTime / queries << " us, compact " << (float)compactRayTime / queries
+		<< " us, mismatches " << rayMismatch << ", max point error " << maxError << endl;
+	cout << "  box:     octree " << (float)boxTime / queries << " us, compact " << (float)compactBoxTime / queries
+		<< " us, mismatches " << boxMismatch << endl;
+}
+
+void benchSpatialIndexes(const ofMesh & mesh, int queries) {
+	Octree octree;
+	CompactOctree compact;
+	LinearIndex linear;
+	OctreeIndex octreeIndex(octree);
+	CompactOctreeIndex compactIndex(compact);
+	Bvh bvh;
+	TerrainPointOctree pointOctree;
+	TerrainTriangleOctree triangleOctree;
+	vector<SpatialIndex *> indexes = { &linear, &octreeIndex, &compactIndex, &bvh, &pointOctree, &triangleOctree };
+
+	// the traces: rays from above the terrain to points on or near it,
+	// vertical and slanted; lander sized boxes; nearest query points
+	//
+	Box b = Octree::meshBounds(mesh);
+	glm::vec3 lo = b.min(), hi = b.max();
+	glm::vec3 size = hi - lo;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> u(0, 1);
+	auto inside = [&] { return lo + glm::vec3(u(rng), u(rng), u(rng)) * size; };
+	vector<Ray> rays;
+	vector<Box> boxes;
+	vector<glm::vec3> points;
+	for (int i = 0; i < queries; i++) {
+		glm::vec3 target = inside();
+		glm::vec3 origin(target.x, hi.y + 10, target.z);
+		if (i % 2) origin += glm::vec3(u(rng) - 0.5f, 0, u(rng) - 0.5f) * size * 0.5f;
+		rays.push_back(Ray(origin, glm::normalize(target - origin)));
+		glm::vec3 c = inside(), half = size * 0.02f;
+		boxes.push_back(Box(c - half, c + half));
+		points.push_back(inside());
+	}
+
+	cout << "spatial indexes (" << mesh.getNumVertices() << " vertices, " << mesh.getNumIndices() / 3
+		<< " triangles, " << queries << " queries each)" << endl;
+	vector<SpatialHit> reference(queries);
+	vector<bool> referenceHit(queries);
+	vector<vector<int>> referenceIds(queries);
+	vector<vector<float>> referenceNearest(queries);
+	for (SpatialIndex *index : indexes) {
+		uint64_t start = ofGetElapsedTimeMicros();
+		index->build(mesh);
+		uint64_t buildTime = ofGetElapsedTimeMicros() - start;
+		std::unique_ptr<SpatialContext> context = index->newContext();
+		bool isReference = index == &linear;
+
+		int hitMismatch = 0, hitCount = 0;
+		double errorSum = 0;
+		float maxError = 0;
+		start = ofGetElapsedTimeMicros();
+		vector<SpatialHit> hits(queries);
+		vector<bool> hit(queries);
+		for (int i = 0; i < queries; i++) hit[i] = index->raycast(rays[i], *context, hits[i]);
+		uint64_t rayTime = ofGetElapsedTimeMicros() - start;
+		for (int i = 0; i < queries; i++) {
+			if (isReference) {
+				reference[i] = hits[i];
+				referenceHit[i] = hit[i];
+			}
+			else if (hit[i] != referenceHit[i]) hitMismatch++;
+			else if (hit[i]) {
+				float e = glm::distance(hits[i].point, reference[i].point);
+				errorSum += e;
+				maxError = std::max(maxError, e);
+				hitCount++;
+			}
+		}
+
+		int overlapMismatch = 0;
+		long overlapTotal = 0;
+		vector<int> ids;
+		uint64_t overlapTime = 0;
+		for (int i = 0; i < queries; i++) {
+			start = ofGetElapsedTimeMicros();
+			index->overlap(boxes[i], *context, ids);
+			overlapTime += ofGetElapsedTimeMicros() - start;
+			overlapTotal += ids.size();
+			if (isReference) referenceIds[i] = ids;
+			else if (ids != referenceIds[i]) overlapMismatch++;
+		}
+
+		// ids can legitimately differ between equidistant vertices, so the
+		// distances are compared
+		//
+		int nearestMismatch = 0;
+		vector<SpatialHit> nearest;
+		vector<float> distances;
+		uint64_t nearestTime = 0;
+		for (int i = 0; i < queries; i++) {
+			start = ofGetElapsedTimeMicros();
+			index->nearest(points[i], 8, *context, nearest);
+			nearestTime += ofGetElapsedTimeMicros() - start;
+			distances.clear();
+			for (const SpatialHit & h : nearest) distances.push_back(h.distance);
+			if (isReference) referenceNearest[i] = distances;
+			else {
+				bool same = distances.size() == referenceNearest[i].size();
+				for (int j = 0; same && j < distances.size(); j++) {
+					same = fabs(distances[j] - referenceNearest[i][j]) <= 1e-3f * (1 + referenceNearest[i][j]);
+				}
+				if (!same) nearestMismatch++;
+			}
+		}
+
+		cout << "  " << index->name() << ": build " << buildTime / 1000.0 << " ms, " << index->memoryUsage() / 1024 << " KB" << endl;
+		cout << "    ray " << (float)rayTime / queries << " us (" << (int)(queries / std::max(1e-6, rayTime / 1e6))
+			<< " rays/s), overlap " << (float)overlapTime / queries
+			<< " us (" << (float)overlapTotal / queries << " vertices), nearest " << (float)nearestTime / queries << " us" << endl;
+		if (!isReference) {
+			cout << "    vs linear: ray hit mismatches " << hitMismatch << ", point error mean "
+				<< (hitCount ? errorSum / hitCount : 0) << " max " << maxError << ", overlap mismatches "
+				<< overlapMismatch << ", nearest mismatches " << nearestMismatch << endl;
+		}
+	}
+}
+
+// one StaticOctree configuration against the octree, for benchStaticOctree
+//
+template <class T>
+static void compareStaticOctree(Octree & octree, int queries) {
+	T tree;
+	uint64_t start = ofGetElapsedTimeMicros();
+	tree.build(octree.mesh);
+	uint64_t buildTime = ofGetElapsedTimeMicros() - start;
+	if (tree.empty()) return;
+	std::unique_ptr<SpatialContext> context = tree.newContext();
+
+	Box b = octree.root.box;
+	TreeNode hitNode;
+	SpatialHit hit;
+	vector<Box> hits, treeHits;
+	uint64_t rayTime = 0, treeRayTime = 0, boxTime = 0, treeBoxTime = 0;
+	int rayMismatch = 0, boxMismatch = 0;
+	for (int i = 0; i < queries; i++) {
+		float x = b.min().x() + (b.max().x() - b.min().x()) * (i * 0.618034f - floor(i * 0.618034f));
+		float z = b.min().z() + (b.max().z() - b.min().z()) * ((float)i / queries);
+		Ray ray(Vector3(x, b.max().y() + 10, z), Vector3(0, -1, 0));
+		start = ofGetElapsedTimeMicros();
+		int id = -1;
+		if (octree.intersect(ray, octree.root, hitNode)) id = octree.closestPoint(hitNode, ray);
+		rayTime += ofGetElapsedTimeMicros() - start;
+		start = ofGetElapsedTimeMicros();
+		int treeId = tree.raycast(ray, *context, hit) ? hit.id : -1;
+		treeRayTime += ofGetElapsedTimeMicros() - start;
+		if (id != treeId) rayMismatch++;
+
+		Box q(Vector3(z - 1, b.min().y(), x - 1), Vector3(z + 1, b.max().y(), x + 1));
+		hits.clear();
+		treeHits.clear();
+		start = ofGetElapsedTimeMicros();
+		octree.intersect(q, octree.root, hits);
+		boxTime += ofGetElapsedTimeMicros() - start;
+		start = ofGetElapsedTimeMicros();
+		tree.overlapCells(q, *context, treeHits);
+		treeBoxTime += ofGetElapsedTimeMicros() - start;
+		bool same = hits.size() == treeHits.size();
+		for (int j = 0; same && j < hits.size(); j++) {
+			same = hits[j].min() == treeHits[j].min() && hits[j].max() == treeHits[j].max();
+		}
+		if (!same) boxMismatch++;
+	}
+	cout << "  " << tree.name() << ": build " << buildTime / 1000.0 << " ms, " << tree.numNodes() << " nodes, "
+		<< tree.memoryUsage() / 1024 << " KB" << endl;
+	cout << "    ray " << (float)treeRayTime / queries << " us (octree " << (float)rayTime / queries << "), box "
+		<< (float)treeBoxTime / queries << " us (octree " << (float)boxTime / queries << "), mismatches: ray "
+		<< rayMismatch << ", box " << boxMismatch << endl;
+}
+
+void benchStaticOctree(Octree & octree, int queries) {
+	cout << "static octree vs octree (" << Octree::countNodes(octree.root) << " nodes, "
+		<< octree.memoryUsage() / 1024 << " KB incl. mesh)" << endl;
+	compareStaticOctree<TerrainPointOctree>(octree, queries);
+	if (octree.mesh.getNumVertices() <= std::numeric_limits<uint16_t>::max()) {
+		compareStaticOctree<TilePointOctree>(octree, queries);
+	}
+}
+
+void benchFrustumCull(TerrainChunks & chunks, int frames) {
+	if (chunks.chunks.empty()) return;
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (const TerrainChunk & c : chunks.chunks) {
+		if (c.numIndices == 0) continue;
+		lo = glm::min(lo, (glm::vec3)c.bounds.min());
+		hi = glm::max(hi, (glm::vec3)c.bounds.max());
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+
+	vector<int> visible, brute;
+	vector<pair<int, int>> ranges;
+	uint64_t cullTime = 0, bruteTime = 0;
+	long visibleTotal = 0, rangeTotal = 0, testedTotal = 0;
+	int mismatches = 0;
+	for (int i = 0; i < frames; i++) {
+		glm::vec3 eye(ofRandom(lo.x, hi.x), ofRandom(hi.y, hi.y + 50), ofRandom(lo.z, hi.z));
+		glm::vec3 target(ofRandom(lo.x, hi.x), lo.y, ofRandom(lo.z, hi.z));
+		Frustum frustum(projection * glm::lookAt(eye, target, glm::vec3(0, 1, 0)));
+
+		uint64_t start = ofGetElapsedTimeMicros();
+		chunks.cull(frustum, visible);
+		chunks.ranges(visible, ranges);
+		cullTime += ofGetElapsedTimeMicros() - start;
+
+		start = ofGetElapsedTimeMicros();
+		brute.clear();
+		for (int c = 0; c < chunks.chunks.size(); c++) {
+			if (chunks.chunks[c].numIndices > 0 && frustum.classify(chunks.chunks[c].bounds) != Frustum::OUTSIDE) {
+				brute.push_back(c);
+			}
+		}
+		bruteTime += ofGetElapsedTimeMicros() - start;
+
+		// node bounds enclose their children's, so the hierarchy should
+		// return exactly the chunks the per chunk test keeps
+		//
+		vector<int> sorted = visible;
+		sort(sorted.begin(), sorted.end());
+		if (sorted != brute) mismatches++;
+
+		visibleTotal += visible.size();
+		rangeTotal += ranges.size();
+		testedTotal += chunks.nodesTested;
+	}
+	cout << "frustum cull (" << chunks.chunks.size() << " chunks, " << frames << " frames)" << endl;
+	cout << "  hierarchy: " << (float)cullTime / frames << " us, " << (float)testedTotal / frames
+		<< " nodes tested, " << (float)visibleTotal / frames << " chunks in " << (float)rangeTotal / frames
+		<< " ranges" << endl;
+	cout << "  per chunk: " << (float)bruteTime / frames << " us, " << mismatches << " frames differ" << endl;
+}
+
+void benchTripleBuffer(int count) {
+	TripleBuffer<SimSnapshot> buffer;
+	std::atomic<bool> finished { false };
+	uint64_t start = ofGetElapsedTimeMicros();
+	std::thread writer([&] {
+		for (int n = 1; n <= count; n++) {
+			SimSnapshot & s = buffer.writeBuffer();
+			s.tick = n;
+			s.landerPos = glm::vec3(n, n, n);
+			s.fuel = n;
+			s.collisions = n;
+			s.particles.resize(n % 200);
+			for (Particle & p : s.particles) p.pos = glm::vec3(n, 0, 0);
+			buffer.publish();
+		}
+		finished = true;
+	});
+
+	long reads = 0, torn = 0, stale = 0;
+	uint64_t last = 0;
+	while (true) {
+		bool done = finished;		// read first, so the last publish is still acquired
+		if (!buffer.acquire()) {
+			if (done) break;
+			continue;
+		}
+		const SimSnapshot & s = buffer.read();
+		uint64_t n = s.tick;
+		reads++;
+		if (n <= last) stale++;
+		last = n;
+		bool ok = s.landerPos == glm::vec3(n, n, n) && s.fuel == n && s.collisions == n && s.particles.size() == n % 200;
+		for (const Particle & p : s.particles) ok = ok && p.pos.x == n;
+		if (!ok) torn++;
+	}
+	writer.join();
+	uint64_t t = ofGetElapsedTimeMicros() - start;
+	cout << "triple buffer (" << count << " snapshots)" << endl;
+	cout << "  " << (float)t / count << " us/publish, " << reads << " reads, " << torn << " torn, "
+		<< stale << " out of order, last tick read " << last << endl;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "LooseOctree.h"
+#include "HeightField.h"
+#include "TerrainChunks.h"
+#include "CompactOctree.h"
+#include "Simulation.h"
+#include "SpatialIndex.h"
+#include "Bvh.h"
+#include "StaticOctree.h"
+
+//  Console benchmarks for the spatial queries, run from the app with the 'b'
+//  key.  Results are printed to stdout.
+//
+
+//  Fly a lander sized box straight down from "start" to the bottom of the
+//  terrain over "frames" frames and report nodes visited per frame for the
+//  collision box, from the root and through an OctreeCursor, and for the
+//  altitude ray, which always starts at the root.  Also counts the frames
+//  where the cursor's box results differ from the root query's.
+//
+void benchOctreeDescent(Octree & octree, const glm::vec3 & landerMin, const glm::vec3 & landerMax,
+	const glm::vec3 & start, int frames);
+
+//  Time k nearest and radius queries at random points inside the terrain bounds
+//  against a brute force scan of every mesh vertex, and count queries where
+//  the two disagree.
+//
+void benchOctreeNearest(const Octree & octree, int queries, int k, float radius);
+
+//  Move "count" small boxes around a cube for "frames" frames, updating each
+//  in a LooseOctree and collecting all overlapping pairs every frame.  The
+//  first frame's pairs are checked against an all-pairs test.
+//
+void benchLooseOctree(int count, int frames);
+
+//  Drop "count" particles onto the terrain and run ParticleList::collide for
+//  "frames" frames, reporting time per pass and how many passes hit the budget.
+//
+void benchParticleCollision(const HeightField & ground, int count, int frames);
+
+//  Load an OBJ with ObjLoader and with ofxAssimpModelLoader (plus the copy
+//  into an ofMesh the game used to make) and report both times.
+//
+void benchObjLoad(const string & path);
+
+//  Build octrees over "mesh" with several leaf sizes and report node count,
+//  build time and the cost of vertical ray, lander sized box and points in
+//  box queries.  Points in box results are checked against leafSize 1.
+//
+void benchOctreeBuild(const ofMesh & mesh, int numLevels);
+
+//  Convert "octree" to a CompactOctree and run the same vertical ray and
+//  lander sized box queries on both.  Reports memory per node, query times,
+//  box queries returning different leaves, ray hits resolving to a different
+//  point and the largest distance between ray hit points (quantization error).
+//
+void benchCompactOctree(Octree & octree, int queries);
+
+//  Build every SpatialIndex backend over "mesh" and run the same seeded ray,
+//  box overlap and 8 nearest traces ("queries" of each) through all of them.
+//  Reports build time, memory, time per query and rays per second, and checks
+//  each backend against the linear scan: rays hitting where it misses (or the
+//  reverse) and the mean and largest distance between hit points, overlaps
+//  returning different vertices and nearest queries with a different
+//  distance list.
+//
+void benchSpatialIndexes(const ofMesh & mesh, int queries);
+
+//  Build the StaticOctree point configurations over the mesh of "octree" and
+//  run the same vertical ray and lander sized box queries through them and
+//  the octree (from the root).  Reports build time, memory, query times and
+//  queries whose results differ from the octree's: the hit vertex, or the
+//  leaf boxes returned.  The 16 bit configuration only runs on meshes it can
+//  index.
+//
+void benchStaticOctree(Octree & octree, int queries);
+
+//  Cull "chunks" against "frames" random camera frusta looking across the
+//  terrain, hierarchically and by testing every chunk, and report time, chunks
+//  and index ranges drawn, and frames where the two visible sets differ.
+//
+void benchFrustumCull(TerrainChunks & chunks, int frames);
+
+//  Publish "count" SimSnapshots from one thread while another acquires and
+//  checks them.  Every field of snapshot n, and every particle, is stamped
+//  with n, so a read mixing two ticks (a torn read) shows up as a mismatch.
+//
+void benchTripleBuffer(int count);
@@ -0,0 +1,328 @@
+#include "Bvh.h"
+#include "MeshWeld.h"
+
+// half the surface area of a box, for the SAH
+//
+static float halfArea(const glm::vec3 & lo, const glm::vec3 & hi) {
+	glm::vec3 d = glm::max(hi - lo, glm::vec3(0));
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+void Bvh::build(const ofMesh & mesh) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	vertices = mesh.getVertices();
+	vector<int> remap, unique;
+	weldVertices(mesh, Octree().weldEpsilon, remap, unique);
+	ids.resize(vertices.size());
+	for (int i = 0; i < ids.size(); i++) ids[i] = unique[remap[i]];
+
+	const vector<ofIndexType> & indices = mesh.getIndices();
+	int n = indices.size() / 3;
+	order.resize(n);
+	triangleMin.resize(n);
+	triangleMax.resize(n);
+	centroids.resize(n);
+	for (int i = 0; i < n; i++) {
+		glm::vec3 a = vertices[indices[i * 3]], b = vertices[indices[i * 3 + 1]], c = vertices[indices[i * 3 + 2]];
+		order[i] = i;
+		triangleMin[i] = glm::min(a, glm::min(b, c));
+		triangleMax[i] = glm::max(a, glm::max(b, c));
+		centroids[i] = (triangleMin[i] + triangleMax[i]) * 0.5f;
+	}
+
+	nodes.clear();
+	nodes.reserve(2 * n);
+	maxDepth = 0;
+	if (n > 0) subdivide(0, n, 0);
+
+	triangles.resize(n * 3);
+	for (int i = 0; i < n; i++) {
+		for (int k = 0; k < 3; k++) triangles[i * 3 + k] = indices[order[i] * 3 + k];
+	}
+	vector<int>().swap(order);
+	vector<glm::vec3>().swap(triangleMin);
+	vector<glm::vec3>().swap(triangleMax);
+	vector<glm::vec3>().swap(centroids);
+	buildMicros = ofGetElapsedTimeMicros() - start;
+}
+
+//  subdivide:  make the node for order[first, first + count) and its subtree;
+//              returns its index
+//
+int Bvh::subdivide(int first, int count, int depth) {
+	int index = nodes.size();
+	nodes.push_back(Node());
+	maxDepth = std::max(maxDepth, depth);
+
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX), cLo(FLT_MAX), cHi(-FLT_MAX);
+	for (int i = first; i < first + count; i++) {
+		int t = order[i];
+		lo = glm::min(lo, triangleMin[t]);
+		hi = glm::max(hi, triangleMax[t]);
+		cLo = glm::min(cLo, centroids[t]);
+		cHi = glm::max(cHi, centroids[t]);
+	}
+	for (int k = 0; k < 3; k++) {
+		nodes[index].min[k] = lo[k];
+		nodes[index].max[k] = hi[k];
+	}
+
+	// best bin boundary over the three axes: cost of a visit plus each side's
+	// triangle tests, weighted by the chance a ray through this node hits it
+	//
+	struct Bin {
+		glm::vec3 lo = glm::vec3(FLT_MAX), hi = glm::vec3(-FLT_MAX);
+		int count = 0;
+	};
+	vector<Bin> bins(numBins);
+	vector<float> leftCost(numBins);
+	float parentArea = halfArea(lo, hi);
+	float bestCost = FLT_MAX;
+	int bestAxis = -1, bestSplit = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = cHi[axis] - cLo[axis];
+		if (extent <= 0) continue;
+		float scale = numBins / extent;
+		for (Bin & b : bins) b = Bin();
+		for (int i = first; i < first + count; i++) {
+			int t = order[i];
+			Bin & b = bins[std::min(numBins - 1, (int)((centroids[t][axis] - cLo[axis]) * scale))];
+			b.lo = glm::min(b.lo, triangleMin[t]);
+			b.hi = glm::max(b.hi, triangleMax[t]);
+			b.count++;
+		}
+		Bin left;
+		for (int s = 1; s < numBins; s++) {
+			left.lo = glm::min(left.lo, bins[s - 1].lo);
+			left.hi = glm::max(left.hi, bins[s - 1].hi);
+			left.count += bins[s - 1].count;
+			leftCost[s] = left.count ? halfArea(left.lo, left.hi) * left.count : 0;
+		}
+		Bin right;
+		for (int s = numBins - 1; s >= 1; s--) {
+			right.lo = glm::min(right.lo, bins[s].lo);
+			right.hi = glm::max(right.hi, bins[s].hi);
+			right.count += bins[s].count;
+			if (right.count == 0 || right.count == count) continue;
+			float cost = traversalCost + triangleCost * (leftCost[s] + halfArea(right.lo, right.hi) * right.count) /
+				std::max(parentArea, 1e-12f);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = s;
+			}
+		}
+	}
+
+	bool mustSplit = count > maxLeafSize;
+	if (depth >= maxStack - 1 || count <= 1 || (!mustSplit && bestCost >= triangleCost * count)) {
+		nodes[index].offset = first;
+		nodes[index].count = count;
+		return index;
+	}
+
+	int mid;
+	if (bestAxis >= 0) {
+		float scale = numBins / (cHi[bestAxis] - cLo[bestAxis]);
+		mid = std::partition(order.begin() + first, order.begin() + first + count, [&](int t) {
+			return std::min(numBins - 1, (int)((centroids[t][bestAxis] - cLo[bestAxis]) * scale)) < bestSplit;
+		}) - order.begin();
+	}
+	else {
+
+		// all centroids in one place: split the list in half
+		//
+		mid = first + count / 2;
+	}
+	subdivide(first, mid - first, depth + 1);
+	int second = subdivide(mid, first + count - mid, depth + 1);
+	nodes[index].offset = second;
+	nodes[index].count = 0;
+	nodes[index].axis = std::max(0, bestAxis);
+	return index;
+}
+
+// ray parameter where the ray enters the node's box, or FLT_MAX if it misses
+// it or enters beyond tMax
+//
+static inline float enter(const float *min, const float *max, const glm::vec3 & o, const glm::vec3 & invDir, float tMax) {
+	float t0 = 0, t1 = tMax;
+	for (int k = 0; k < 3; k++) {
+		float a = (min[k] - o[k]) * invDir[k];
+		float b = (max[k] - o[k]) * invDir[k];
+		t0 = std::max(t0, std::min(a, b));
+		t1 = std::min(t1, std::max(a, b));
+	}
+	return t0 <= t1 ? t0 : FLT_MAX;
+}
+
+int Bvh::closestVertex(int triangle, const glm::vec3 & p) const {
+	int best = triangles[triangle * 3];
+	for (int k = 1; k < 3; k++) {
+		int v = triangles[triangle * 3 + k];
+		if (glm::distance2(vertices[v], p) < glm::distance2(vertices[best], p)) best = v;
+	}
+	return best;
+}
+
+bool Bvh::raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const {
+	context.nodesVisited = 0;
+	if (nodes.empty()) return false;
+	glm::vec3 o = ray.origin;
+	glm::vec3 d = glm::normalize((glm::vec3)ray.direction);
+	glm::vec3 invDir = glm::vec3(1) / d;
+	float best = FLT_MAX;
+	int bestTriangle = -1;
+
+	pair<int, float> stack[maxStack];
+	int sp = 0;
+	if (enter(nodes[0].min, nodes[0].max, o, invDir, best) == FLT_MAX) return false;
+	int node = 0;
+	while (true) {
+		context.nodesVisited++;
+		const Node & n = nodes[node];
+		int next = -1;
+		if (n.count > 0) {
+			for (int i = n.offset; i < n.offset + n.count; i++) {
+				float t;
+				if (intersectTriangle(o, d, vertices[triangles[i * 3]], vertices[triangles[i * 3 + 1]],
+					vertices[triangles[i * 3 + 2]], t) && t < best) {
+					best = t;
+					bestTriangle = i;
+				}
+			}
+		}
+		else {
+			int a = node + 1, b = n.offset;
+			float ta = enter(nodes[a].min, nodes[a].max, o, invDir, best);
+			float tb = enter(nodes[b].min, nodes[b].max, o, invDir, best);
+			if (tb < ta) {
+				std::swap(a, b);
+				std::swap(ta, tb);
+			}
+			if (ta != FLT_MAX) {
+				next = a;
+				if (tb != FLT_MAX) stack[sp++] = make_pair(b, tb);
+			}
+		}
+
+		// nodes left on the stack may now be beyond the closest hit
+		//
+		while (next == -1 && sp > 0) {
+			sp--;
+			if (stack[sp].second < best) next = stack[sp].first;
+		}
+		if (next == -1) break;
+		node = next;
+	}
+	if (bestTriangle == -1) return false;
+	hitRtn.point = o + d * best;
+	hitRtn.distance = best;
+	hitRtn.id = ids[closestVertex(bestTriangle, hitRtn.point)];
+	return true;
+}
+
+int Bvh::overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const {
+	idsRtn.clear();
+	context.nodesVisited = 0;
+	if (nodes.empty()) return 0;
+	glm::vec3 lo = box.min(), hi = box.max();
+	int stack[maxStack + 2];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0) {
+		const Node & n = nodes[stack[--sp]];
+		context.nodesVisited++;
+		if (n.min[0] > hi.x || n.max[0] < lo.x || n.min[1] > hi.y || n.max[1] < lo.y || n.min[2] > hi.z || n.max[2] < lo.z) continue;
+		if (n.count == 0) {
+			stack[sp++] = n.offset;
+			stack[sp++] = &n - &nodes[0] + 1;
+			continue;
+		}
+		for (int i = n.offset * 3; i < (n.offset + n.count) * 3; i++) {
+			if (box.inside(vertices[triangles[i]])) idsRtn.push_back(ids[triangles[i]]);
+		}
+	}
+	sort(idsRtn.begin(), idsRtn.end());
+	idsRtn.erase(std::unique(idsRtn.begin(), idsRtn.end()), idsRtn.end());
+	return idsRtn.size();
+}
+
+int Bvh::overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const {
+	vector<int> inside;
+	overlap(box, context, inside);
+	for (int id : inside) cellsRtn.push_back(Box(vertices[id], vertices[id]));
+	return inside.size();
+}
+
+//  nearest:  best first over the nodes by distance to their boxes, as in
+//            Octree::nearest
+//
+int Bvh::nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const {
+	hitsRtn.clear();
+	context.nodesVisited = 0;
+	if (k <= 0 || nodes.empty()) return 0;
+	auto distance2 = [&](const Node & n) {
+		float d = 0;
+		for (int a = 0; a < 3; a++) {
+			float e = std::max(0.0f, std::max(n.min[a] - p[a], p[a] - n.max[a]));
+			d += e * e;
+		}
+		return d;
+	};
+	auto farther = [](const pair<float, int> & a, const pair<float, int> & b) { return a.first > b.first; };
+	auto closer = [](const PointHit & a, const PointHit & b) { return a.second < b.second; };
+	vector<PointHit> found;
+	vector<pair<float, int>> heap(1, make_pair(distance2(nodes[0]), 0));
+	while (!heap.empty()) {
+		pop_heap(heap.begin(), heap.end(), farther);
+		pair<float, int> e = heap.back();
+		heap.pop_back();
+		if (found.size() == k && e.first >= found.front().second) break;
+		context.nodesVisited++;
+		const Node & n = nodes[e.second];
+		if (n.count == 0) {
+			for (int child : { e.second + 1, (int)n.offset }) {
+				float d = distance2(nodes[child]);
+				if (found.size() < k || d < found.front().second) {
+					heap.push_back(make_pair(d, child));
+					push_heap(heap.begin(), heap.end(), farther);
+				}
+			}
+			continue;
+		}
+		for (int i = n.offset * 3; i < (n.offset + n.count) * 3; i++) {
+			int id = ids[triangles[i]];
+			float d = glm::distance2(vertices[id], p);
+			if (found.size() == k && d >= found.front().second) continue;
+			bool seen = false;
+			for (int j = 0; j < found.size() && !seen; j++) seen = found[j].first == id;
+			if (seen) continue;
+			if (found.size() == k) {
+				pop_heap(found.begin(), found.end(), closer);
+				found.pop_back();
+			}
+			found.push_back(make_pair(id, d));
+			push_heap(found.begin(), found.end(), closer);
+		}
+	}
+	sort_heap(found.begin(), found.end(), closer);
+	hitsRtn.resize(found.size());
+	for (int i = 0; i < found.size(); i++) {
+		hitsRtn[i].id = found[i].first;
+		hitsRtn[i].point = vertices[found[i].first];
+		hitsRtn[i].distance = sqrt(found[i].second);
+	}
+	return hitsRtn.size();
+}
+
+Box Bvh::bounds() const {
+	if (nodes.empty()) return Box();
+	const Node & n = nodes[0];
+	return Box(Vector3(n.min[0], n.min[1], n.min[2]), Vector3(n.max[0], n.max[1], n.max[2]));
+}
+
+size_t Bvh::memoryUsage() const {
+	return nodes.capacity() * sizeof(Node) + triangles.capacity() * sizeof(uint32_t) +
+		vertices.capacity() * sizeof(glm::vec3) + ids.capacity() * sizeof(int);
+}
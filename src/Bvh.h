@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ofMain.h"
+#include "SpatialIndex.h"
+
+//  Bounding volume hierarchy over the terrain triangles, a SpatialIndex
+//  backend for ray casts (altitude ray, picking).
+//
+//  Octree cells split space evenly, so dense mountains get the same depth of
+//  cells as the plains next to them.  Here every split is chosen by the
+//  surface area heuristic: triangle centroids are binned along each axis and
+//  the bin boundary with the lowest estimated ray cost wins, or the node
+//  stays a leaf when testing its triangles is cheaper.  Ray hits are exact
+//  triangle intersections, the same as LinearIndex.
+//
+//  Nodes are 32 bytes in depth first order: a node's first child follows it
+//  and it stores the index of the second.  Leaves store a range of the
+//  reordered triangle list.  Traversal keeps a small stack of nodes, tests
+//  both children's boxes and descends into the nearer one first, skipping
+//  boxes beyond the closest hit so far.
+//
+//  Vertices that belong to no triangle aren't indexed, so overlap() and
+//  nearest() don't return them.
+//
+class Bvh : public SpatialIndex {
+public:
+	const char * name() const override { return "bvh"; }
+	void build(const ofMesh & mesh) override;
+	bool raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const override;
+	int overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const override;
+	int overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const override;
+	int nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const override;
+	Box bounds() const override;
+	size_t memoryUsage() const override;
+
+	int numNodes() const { return nodes.size(); }
+	int numTriangles() const { return triangles.size() / 3; }
+	int maxDepth = 0;			// build: deepest leaf
+	uint64_t buildMicros = 0;	// build: time taken
+
+	// build: centroid bins per axis, and the relative cost of a node visit
+	// and a triangle test.  Leaves hold at most maxLeafSize triangles.
+	//
+	int numBins = 16;
+	float traversalCost = 1;
+	float triangleCost = 1;
+	int maxLeafSize = 16;
+
+private:
+	struct Node {
+		float min[3];
+		uint32_t offset;	// leaf: first triangle; interior: second child
+		float max[3];
+		uint16_t count;		// leaf: triangles, 0 for interior nodes
+		uint16_t axis;		// interior: split axis
+	};
+	static_assert(sizeof(Node) == 32, "BVH nodes are 32 bytes");
+
+	static const int maxStack = 64;		// traversal stack, and so the tree depth
+
+	int subdivide(int first, int count, int depth);
+	int closestVertex(int triangle, const glm::vec3 & p) const;
+
+	vector<Node> nodes;
+	vector<uint32_t> triangles;		// vertex indices, three per triangle, in leaf order
+	vector<glm::vec3> vertices;
+	vector<int> ids;				// weldUnique id of each mesh vertex
+
+	vector<int> order;				// build scratch: triangle numbers in leaf order
+	vector<glm::vec3> triangleMin, triangleMax, centroids;
+};
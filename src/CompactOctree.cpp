@@ -0,0 +1,401 @@
+#include "CompactOctree.h"
+
+//  childBox:  box of one octant, with the same arithmetic as
+//             Octree::subDivideBox8 so the boxes match it bit for bit
+//
+Box CompactOctree::childBox(const Box & box, int octant) {
+	Vector3 min = box.min();
+	Vector3 max = box.max();
+	Vector3 center = (max - min) / 2 + min;
+	Vector3 dx((max.x() - min.x()) / 2, 0, 0);
+	Vector3 dy(0, (max.y() - min.y()) / 2, 0);
+	Vector3 dz(0, 0, (max.z() - min.z()) / 2);
+	Vector3 lo = min, hi = center;
+	int floor = octant & 3;
+	if (floor >= 1) { lo = lo + dx; hi = hi + dx; }
+	if (floor >= 2) { lo = lo + dz; hi = hi + dz; }
+	if (floor == 3) { lo = lo + -dx; hi = hi + -dx; }
+	if (octant >= 4) { lo = lo + dy; hi = hi + dy; }
+	return Box(lo, hi);
+}
+
+static uint16_t quantize(float v, float lo, float size) {
+	if (size <= 0) return 0;
+	return (uint16_t)ofClamp((v - lo) / size * 65535 + 0.5f, 0, 65535);
+}
+
+glm::vec3 CompactOctree::dequantize(const Box & box, const Point & q) {
+	Vector3 size = (box.max() - box.min()) * (1.0f / 65535);
+	return glm::vec3(box.min().x() + q.x * size.x(), box.min().y() + q.y * size.y(), box.min().z() + q.z * size.z());
+}
+
+void CompactOctree::clear() {
+	vector<Node>().swap(nodes);
+	vector<uint32_t>().swap(leafPoints);
+	vector<Point>().swap(points);
+	vector<int>().swap(ids);
+	image.close();
+	useVectors();
+	boxMismatches = 0;
+}
+
+void CompactOctree::useVectors() {
+	nodeData = nodes.data();
+	leafData = leafPoints.data();
+	pointData = points.data();
+	idData = ids.data();
+	nodeCount = nodes.size();
+	leafCount = leafPoints.size();
+	pointCount = points.size();
+	idCount = ids.size();
+}
+
+//  build:  breadth first copy of the tree.  Child boxes are only checked
+//          against the octant they are assumed to be, never stored; a tree
+//          whose children aren't plain octants (boxMismatches > 0) still
+//          converts, but queries then use the octant boxes.
+//
+void CompactOctree::build(const Octree & octree, bool keepIds) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	clear();
+	rootBox = octree.root.box;
+
+	vector<const TreeNode *> queue(1, &octree.root);
+	vector<Box> boxes(1, rootBox);
+	for (int i = 0; i < queue.size(); i++) {
+		if (queue.size() > 0xffffff || leafPoints.size() > 0xffffff) {
+			cout << "compact octree: more than 2^24 nodes or leaves, not converted" << endl;
+			clear();
+			return;
+		}
+		const TreeNode & node = *queue[i];
+		Box box = boxes[i];
+		Node n;
+		if (node.children.empty()) {
+			n.info = leafPoints.size() << 8;
+			leafPoints.push_back(points.size());
+			Vector3 size = box.max() - box.min();
+			for (int k = 0; k < node.points.size(); k++) {
+				const glm::vec3 & p = octree.mesh.getVertex(node.points[k]);
+				points.push_back({ quantize(p.x, box.min().x(), size.x()), quantize(p.y, box.min().y(), size.y()),
+					quantize(p.z, box.min().z(), size.z()) });
+				if (keepIds) ids.push_back(node.points[k]);
+			}
+		}
+		else {
+			// siblings go in octant order, which is also the order
+			// Octree::subdivide adds them in
+			//
+			const TreeNode *child[8] = { NULL };
+			Vector3 center = box.center();
+			for (int k = 0; k < node.children.size(); k++) {
+				Vector3 c = node.children[k].box.center();
+				int bits = (c.x() >= center.x()) | ((c.z() >= center.z()) << 1) | ((c.y() >= center.y()) << 2);
+				child[Octree::octantOrder[bits]] = &node.children[k];
+			}
+			n.info = queue.size() << 8;
+			for (int c = 0; c < 8; c++) {
+				if (child[c] == NULL) continue;
+				n.info |= 1 << c;
+				Box cb = childBox(box, c);
+				if (cb.min() != child[c]->box.min() || cb.max() != child[c]->box.max()) boxMismatches++;
+				queue.push_back(child[c]);
+				boxes.push_back(cb);
+			}
+		}
+		nodes.push_back(n);
+	}
+	leafPoints.push_back(points.size());
+	nodes.shrink_to_fit();
+	leafPoints.shrink_to_fit();
+	points.shrink_to_fit();
+	ids.shrink_to_fit();
+	useVectors();
+	if (boxMismatches > 0) cout << "compact octree: " << boxMismatches << " child boxes are not octants of their parent" << endl;
+	buildMicros = ofGetElapsedTimeMicros() - start;
+}
+
+size_t CompactOctree::nodeMemory() const {
+	return nodeCount * sizeof(Node) + leafCount * sizeof(uint32_t);
+}
+
+size_t CompactOctree::memoryUsage() const {
+	return nodeMemory() + pointCount * sizeof(Point) + idCount * sizeof(int);
+}
+
+//  ".lmoc" image layout
+//
+struct CompactOctreeHeader {
+	char magic[4];				// "LMOC"
+	uint32_t version;
+	float rootMin[3], rootMax[3];
+	uint64_t nodeCount, leafCount, pointCount, idCount;
+	uint64_t nodeOffset, leafOffset, pointOffset, idOffset;		// bytes from the start of the file
+};
+
+static const char imageMagic[4] = { 'L', 'M', 'O', 'C' };
+static const uint64_t imageAlign = 64;
+
+static uint64_t alignUp(uint64_t offset) {
+	return (offset + imageAlign - 1) & ~(imageAlign - 1);
+}
+
+static void pad(ofstream & out, uint64_t offset) {
+	static const char zeros[64] = { 0 };
+	uint64_t at = out.tellp();
+	if (offset > at) out.write(zeros, offset - at);
+}
+
+bool CompactOctree::save(const string & path) const {
+	CompactOctreeHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, imageMagic, sizeof(h.magic));
+	h.version = version;
+	for (int i = 0; i < 3; i++) {
+		h.rootMin[i] = rootBox.min()[i];
+		h.rootMax[i] = rootBox.max()[i];
+	}
+	h.nodeCount = nodeCount;
+	h.leafCount = leafCount;
+	h.pointCount = pointCount;
+	h.idCount = idCount;
+	h.nodeOffset = alignUp(sizeof(h));
+	h.leafOffset = alignUp(h.nodeOffset + nodeCount * sizeof(Node));
+	h.pointOffset = alignUp(h.leafOffset + leafCount * sizeof(uint32_t));
+	h.idOffset = alignUp(h.pointOffset + pointCount * sizeof(Point));
+
+	ofstream out(path, ios::binary);
+	if (!out) return false;
+	out.write((const char *)&h, sizeof(h));
+	pad(out, h.nodeOffset);
+	out.write((const char *)nodeData, nodeCount * sizeof(Node));
+	pad(out, h.leafOffset);
+	out.write((const char *)leafData, leafCount * sizeof(uint32_t));
+	pad(out, h.pointOffset);
+	out.write((const char *)pointData, pointCount * sizeof(Point));
+	pad(out, h.idOffset);
+	out.write((const char *)idData, idCount * sizeof(int));
+	return (bool)out;
+}
+
+// true if bytes at offset lie inside a file of "size" bytes, without
+// overflowing on offsets near 2^64
+//
+static bool fits(uint64_t offset, uint64_t bytes, uint64_t size) {
+	return offset <= size && bytes <= size - offset;
+}
+
+//  map:  use an image written by save() in place.  The header is checked,
+//        then the nodes and leaf table are walked once (validate()); the
+//        points are paged in as queries touch them.
+//
+bool CompactOctree::map(const string & path) {
+	clear();
+	if (!image.open(path) || image.size() < sizeof(CompactOctreeHeader)) {
+		clear();
+		return false;
+	}
+	const CompactOctreeHeader *h = (const CompactOctreeHeader *)image.data();
+	uint64_t size = image.size();
+	bool ok = memcmp(h->magic, imageMagic, sizeof(imageMagic)) == 0 && h->version == version &&
+		h->nodeCount > 0 && h->nodeCount <= 0xffffff && h->leafCount <= 0x1000000 && h->pointCount <= 0x7fffffff &&
+		(h->idCount == 0 || h->idCount == h->pointCount) &&
+		h->nodeOffset % imageAlign == 0 && fits(h->nodeOffset, h->nodeCount * sizeof(Node), size) &&
+		h->leafOffset % imageAlign == 0 && fits(h->leafOffset, h->leafCount * sizeof(uint32_t), size) &&
+		h->pointOffset % imageAlign == 0 && fits(h->pointOffset, h->pointCount * sizeof(Point), size) &&
+		h->idOffset % imageAlign == 0 && fits(h->idOffset, h->idCount * sizeof(int), size);
+	if (ok) {
+		rootBox = Box(Vector3(h->rootMin[0], h->rootMin[1], h->rootMin[2]), Vector3(h->rootMax[0], h->rootMax[1], h->rootMax[2]));
+		nodeData = (const Node *)(image.data() + h->nodeOffset);
+		leafData = (const uint32_t *)(image.data() + h->leafOffset);
+		pointData = (const Point *)(image.data() + h->pointOffset);
+		idData = (const int *)(image.data() + h->idOffset);
+		nodeCount = h->nodeCount;
+		leafCount = h->leafCount;
+		pointCount = h->pointCount;
+		idCount = h->idCount;
+		ok = validate();
+	}
+	if (!ok) {
+		clear();
+		return false;
+	}
+	return true;
+}
+
+//  validate:  check that queries on a mapped image stay inside its arrays.
+//             Children must come after their parent (so traversal ends)
+//             and inside the node array, at most maxDepth levels down;
+//             leaf numbers must have a range in the leaf table, and the
+//             ranges must be ascending and end inside the point array.
+//
+bool CompactOctree::validate() const {
+	vector<uint8_t> depth(nodeCount, 0);
+	for (size_t i = 0; i < nodeCount; i++) {
+		const Node & node = nodeData[i];
+		size_t index = node.index();
+		int mask = node.childMask();
+		if (mask == 0) {
+			if (index + 1 >= leafCount) return false;
+			continue;
+		}
+		int children = 0;
+		for (int c = 0; c < 8; c++) children += (mask >> c) & 1;
+		if (index <= i || index + children > nodeCount || depth[i] >= maxDepth) return false;
+		for (int c = 0; c < children; c++) depth[index + c] = std::max<int>(depth[index + c], depth[i] + 1);
+	}
+	for (size_t n = 0; n < leafCount; n++) {
+		if (leafData[n] > pointCount || (n > 0 && leafData[n] < leafData[n - 1])) return false;
+	}
+	for (size_t k = 0; k < idCount; k++) {
+		if (idData[k] < 0) return false;
+	}
+	return true;
+}
+
+//  findLeaf:  depth first search for the first leaf crossed by the ray, as in
+//             Octree::findLeaf, then the leaf point nearest the ray's line
+//             as in Octree::closestPoint
+//
+bool CompactOctree::findLeaf(const Ray & ray, int index, const Box & box, glm::vec3 & pointRtn, int & idRtn) const {
+	if (!box.intersect(ray, -1000, 1000)) return false;
+	const Node & node = nodeData[index];
+	int mask = node.childMask();
+	if (mask == 0) {
+		int first = leafData[node.index()], last = leafData[node.index() + 1];
+		if (first == last) return false;
+		glm::vec3 o = ray.origin;
+		glm::vec3 d = glm::normalize((glm::vec3)ray.direction);
+		float bestDist = FLT_MAX;
+		for (int k = first; k < last; k++) {
+			glm::vec3 p = dequantize(box, pointData[k]);
+			glm::vec3 w = p - o;
+			float t = glm::dot(w, d);
+			float dist = glm::dot(w, w) - t * t;
+			if (dist < bestDist) {
+				bestDist = dist;
+				pointRtn = p;
+				idRtn = idCount == 0 ? -1 : idData[k];
+			}
+		}
+		return true;
+	}
+	int child = node.index();
+	for (int c = 0; c < 8; c++) {
+		if (!(mask & (1 << c))) continue;
+		if (findLeaf(ray, child++, childBox(box, c), pointRtn, idRtn)) return true;
+	}
+	return false;
+}
+
+bool CompactOctree::intersect(const Ray & ray, glm::vec3 & pointRtn, int & idRtn) const {
+	if (empty()) return false;
+	return findLeaf(ray, 0, rootBox, pointRtn, idRtn);
+}
+
+void CompactOctree::collectLeaves(const Box & query, int index, const Box & box, vector<Box> & boxListRtn) const {
+	if (!box.overlap(query)) return;
+	const Node & node = nodeData[index];
+	int mask = node.childMask();
+	if (mask == 0) {
+		if (leafData[node.index() + 1] > leafData[node.index()]) boxListRtn.push_back(box);
+		return;
+	}
+	int child = node.index();
+	for (int c = 0; c < 8; c++) {
+		if (!(mask & (1 << c))) continue;
+		collectLeaves(query, child++, childBox(box, c), boxListRtn);
+	}
+}
+
+bool CompactOctree::intersect(const Box & box, vector<Box> & boxListRtn) const {
+	if (empty()) return false;
+	int count = boxListRtn.size();
+	collectLeaves(box, 0, rootBox, boxListRtn);
+	return boxListRtn.size() > count;
+}
+
+int CompactOctree::pointsInBox(const Box & query, vector<int> & pointsRtn) const {
+	pointsRtn.clear();
+	if (empty()) return 0;
+	vector<pair<int, Box>> stack(1, make_pair(0, rootBox));
+	while (!stack.empty()) {
+		int index = stack.back().first;
+		Box box = stack.back().second;
+		stack.pop_back();
+		if (!box.overlap(query)) continue;
+		const Node & node = nodeData[index];
+		int mask = node.childMask();
+		if (mask == 0) {
+			for (int k = leafData[node.index()]; k < leafData[node.index() + 1]; k++) {
+				if (query.inside(dequantize(box, pointData[k]))) pointsRtn.push_back(pointId(k));
+			}
+			continue;
+		}
+		int child = node.index();
+		for (int c = 0; c < 8; c++) {
+			if (mask & (1 << c)) stack.push_back(make_pair(child++, childBox(box, c)));
+		}
+	}
+	sort(pointsRtn.begin(), pointsRtn.end());
+	pointsRtn.erase(unique(pointsRtn.begin(), pointsRtn.end()), pointsRtn.end());
+	return pointsRtn.size();
+}
+
+//  nearest:  best first search as in Octree::nearest, carrying each queued
+//            node's box since nodes don't store one
+//
+int CompactOctree::nearest(const glm::vec3 & p, int k, CompactOctreeScratch & scratch, vector<PointHit> & hitsRtn,
+	vector<glm::vec3> * pointsRtn) const {
+	typedef CompactOctreeScratch::Found Found;
+	hitsRtn.clear();
+	if (pointsRtn) pointsRtn->clear();
+	if (k <= 0 || empty()) return 0;
+	vector<Found> & found = scratch.found;
+	vector<CompactOctreeScratch::Entry> & heap = scratch.nodeHeap;
+	found.clear();
+	heap.assign(1, { Octree::distance2(rootBox, p), 0, rootBox });
+	while (!heap.empty()) {
+		pop_heap(heap.begin(), heap.end());
+		CompactOctreeScratch::Entry e = heap.back();
+		heap.pop_back();
+		if (found.size() == k && e.dist >= found.front().dist) break;
+		const Node & node = nodeData[e.node];
+		int mask = node.childMask();
+		if (mask == 0) {
+			for (int i = leafData[node.index()]; i < leafData[node.index() + 1]; i++) {
+				glm::vec3 q = dequantize(e.box, pointData[i]);
+				float d = glm::distance2(q, p);
+				if (found.size() == k && d >= found.front().dist) continue;
+				int id = pointId(i);
+				bool seen = false;
+				for (int j = 0; j < found.size() && !seen; j++) seen = found[j].id == id;
+				if (seen) continue;
+				if (found.size() == k) {
+					pop_heap(found.begin(), found.end());
+					found.pop_back();
+				}
+				found.push_back({ d, id, q });
+				push_heap(found.begin(), found.end());
+			}
+			continue;
+		}
+		int child = node.index();
+		for (int c = 0; c < 8; c++) {
+			if (!(mask & (1 << c))) continue;
+			Box box = childBox(e.box, c);
+			float d = Octree::distance2(box, p);
+			if (found.size() < k || d < found.front().dist) {
+				heap.push_back({ d, child, box });
+				push_heap(heap.begin(), heap.end());
+			}
+			child++;
+		}
+	}
+	sort_heap(found.begin(), found.end());
+	for (const Found & f : found) {
+		hitsRtn.push_back(make_pair(f.id, f.dist));
+		if (pointsRtn) pointsRtn->push_back(f.point);
+	}
+	return hitsRtn.size();
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "MappedFile.h"
+
+//  Read-only, compressed copy of an Octree for terrains too large to keep the
+//  pointer tree (and its copy of the mesh) resident.
+//
+//  Nodes are 4 bytes in a flat breadth first array.  A node stores no bounds:
+//  Octree splits every node into its eight equal octants, so a child's box is
+//  recomputed from its parent's box and its octant while walking down from the
+//  root box.  Interior nodes keep a mask of their occupied octants and the
+//  index of their first child (siblings are contiguous, in octant order).
+//  Leaves have an empty mask and keep their leaf number, which indexes a table
+//  of point ranges (4 more bytes per leaf).  Points are stored as three 16 bit
+//  offsets inside the leaf's box, so the position error is at most 1/131070 of
+//  the leaf size.  Up to 2^24 nodes and 2^24 leaves.
+//
+//  Mesh vertex indices of the points are kept only if asked for in build().
+//
+//  save() writes the arrays to an ".lmoc" image (header plus 64 byte aligned
+//  arrays, like MeshFile), and map() uses such an image in place from a read
+//  only mapping, so processes mapping the same file share one copy of the
+//  tree in the page cache.  map() rejects images whose nodes or leaf ranges
+//  would send a query outside the arrays.
+//
+// Work space for CompactOctree::nearest.  Keep one per caller, as with
+// OctreeQueryScratch, so repeated queries reuse its storage.
+//
+class CompactOctreeScratch {
+public:
+	struct Entry {
+		float dist;
+		int node;
+		Box box;
+		bool operator<(const Entry & e) const { return dist > e.dist; }
+	};
+	struct Found {
+		float dist;
+		int id;
+		glm::vec3 point;
+		bool operator<(const Found & f) const { return dist < f.dist; }
+	};
+
+	vector<Entry> nodeHeap;
+	vector<Found> found;
+};
+
+class CompactOctree {
+public:
+	static const uint32_t version = 1;
+
+	CompactOctree() {}
+	CompactOctree(const CompactOctree &) = delete;
+	CompactOctree & operator=(const CompactOctree &) = delete;
+
+	void build(const Octree & octree, bool keepIds = false);
+	void clear();
+	bool save(const string & path) const;
+	bool map(const string & path);
+	bool isMapped() const { return image.isOpen(); }
+	bool empty() const { return numNodes() == 0; }
+
+	// same traversal and results as the Octree queries of the same name, but
+	// a ray hit returns the leaf point closest to the ray instead of the leaf.
+	// idRtn is its mesh vertex index, or -1 if ids weren't kept.  Queries
+	// don't modify the tree, so any number of threads can run them at once.
+	//
+	bool intersect(const Ray & ray, glm::vec3 & pointRtn, int & idRtn) const;
+	bool intersect(const Box & box, vector<Box> & boxListRtn) const;
+
+	// point queries as Octree::pointsInBox and Octree::nearest, on the
+	// quantized positions.  Points are identified by mesh vertex index if ids
+	// were kept, otherwise by their position in the point array.  nearest()
+	// also returns the hits' positions if pointsRtn is given.
+	//
+	int pointsInBox(const Box & box, vector<int> & pointsRtn) const;
+	int nearest(const glm::vec3 & p, int k, CompactOctreeScratch & scratch, vector<PointHit> & hitsRtn,
+		vector<glm::vec3> * pointsRtn = NULL) const;
+
+	size_t memoryUsage() const;
+	size_t nodeMemory() const;		// nodes plus leaf ranges, without the points
+	int numNodes() const { return nodeCount; }
+	int numPoints() const { return pointCount; }
+
+	Box rootBox;
+	int boxMismatches = 0;	// build: children whose box isn't their parent's octant
+	uint64_t buildMicros = 0;	// build: time taken
+
+private:
+	struct Node {
+		uint32_t info;		// low 8 bits child mask, high 24 bits first child or leaf number
+
+		int childMask() const { return info & 0xff; }
+		int index() const { return info >> 8; }
+	};
+
+	struct Point {
+		uint16_t x, y, z;
+	};
+
+	static const int maxDepth = 64;		// levels below the root a mapped image may have
+
+	static Box childBox(const Box & box, int octant);
+	static glm::vec3 dequantize(const Box & box, const Point & q);
+	bool findLeaf(const Ray & ray, int node, const Box & box, glm::vec3 & pointRtn, int & idRtn) const;
+	void collectLeaves(const Box & query, int node, const Box & box, vector<Box> & boxListRtn) const;
+	void useVectors();
+	bool validate() const;
+	int pointId(int k) const { return idCount == 0 ? k : idData[k]; }
+
+	// the arrays queries read: the vectors below after build(), the image
+	// after map()
+	//
+	const Node *nodeData = NULL;
+	const uint32_t *leafData = NULL;
+	const Point *pointData = NULL;
+	const int *idData = NULL;
+	size_t nodeCount = 0, leafCount = 0, pointCount = 0, idCount = 0;
+
+	vector<Node> nodes;
+	vector<uint32_t> leafPoints;	// leaf n's points are [leafPoints[n], leafPoints[n + 1])
+	vector<Point> points;
+	vector<int> ids;
+	MappedFile image;
+};
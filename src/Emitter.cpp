@@ -1,4 +1,5 @@
 #include "ofApp.h"
+#include "Util.h"
 //----------------------------------------------------------------------------------
 //
 // This example code demonstrates the use of an "Emitter" class to emit Sprites
@@ -32,6 +33,7 @@
 //  Add a Sprite to the Sprite System
 //
 void ParticleList::add(Particle s) {
+	s.serial = nextSerial++;
 	particles.push_back(s);
 }
 
@@ -74,6 +76,91 @@ void ParticleList::update() {
 	}
 }
 
+// spread the low 16 bits of v out to the even bits, for a 2D Morton key
+//
+static uint32_t spreadBits(uint32_t v) {
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+//  Bounce particles off the ground.  The whole set is handled in one pass,
+//  ordered along a Z curve over the height grid so neighboring particles read
+//  neighboring heights.  Particles below the ground are lifted onto it and
+//  their velocity is reflected about the ground normal, keeping "restitution"
+//  of the normal speed and losing "friction" of the tangential speed.
+//
+//  The pass stops when collideBudgetMicros (sorting included) is used up and
+//  the next call resumes from there in the same order, so a huge burst cannot
+//  stall the frame.  At least one batch is always tested, even when the sort
+//  took the whole budget.  The order is rebuilt only when a pass has finished.
+//  Expired particles are erased between calls, which shifts indices, so each
+//  entry also remembers the particle's serial and is looked up again by it
+//  when the index no longer matches.  Particles added during a pass wait for
+//  the next one; particles removed during it are skipped.
+//
+void ParticleList::collide(const HeightField & ground) {
+	int n = particles.size();
+	if (n == 0 || !ground.isBaked()) return;
+	uint64_t start = ofGetElapsedTimeMicros();
+
+	if (collideStart < 0) {
+		collideOrder.resize(n);
+		collideSerial.resize(n);
+		for (int i = 0; i < n; i++) {
+			const glm::vec3 & p = particles[i].pos;
+			uint32_t cx = (uint32_t)glm::clamp((p.x - ground.origin.x) / ground.cellSize, 0.0f, 65535.0f);
+			uint32_t cz = (uint32_t)glm::clamp((p.z - ground.origin.z) / ground.cellSize, 0.0f, 65535.0f);
+			uint64_t key = spreadBits(cx) | (spreadBits(cz) << 1);
+			collideOrder[i] = (key << 32) | (uint32_t)i;
+			collideSerial[i] = particles[i].serial;
+		}
+		sort(collideOrder.begin(), collideOrder.end());
+		collideStart = 0;
+	}
+
+	const int batch = 1024;
+	int m = collideOrder.size();
+	int k = collideStart;
+	while (k < m) {
+		int end = std::min(k + batch, m);
+		for (; k < end; k++) {
+			int index = collideOrder[k] & 0xffffffff;
+			uint32_t serial = collideSerial[index];
+			if (index >= n || particles[index].serial != serial) {
+
+				// the list changed since the sort; erase keeps the order, so
+				// serials still increase along it
+				//
+				auto found = lower_bound(particles.begin(), particles.end(), serial,
+					[](const Particle & p, uint32_t s) { return p.serial < s; });
+				if (found == particles.end() || found->serial != serial) continue;	// expired
+				index = found - particles.begin();
+			}
+			Particle & particle = particles[index];
+			float h = ground.heightAt(particle.pos.x, particle.pos.z);
+			if (particle.pos.y >= h) continue;
+
+			particle.pos.y = h;
+			ofVec3f normal = ground.normalAt(particle.pos.x, particle.pos.z);
+			ofVec3f v = particle.velocity;
+			if (v.dot(normal) >= 0) continue;		// already moving away
+
+			// the reflection flips the normal component and keeps the tangential one
+			//
+			ofVec3f r = reflectVector(v, normal);
+			ofVec3f rn = r.dot(normal) * normal;
+			ofVec3f rt = r - rn;
+			particle.velocity = glm::vec3(rt * (1 - friction) + rn * restitution);
+		}
+		if (ofGetElapsedTimeMicros() - start > collideBudgetMicros) break;
+	}
+	collideStart = k < m ? k : -1;
+}
+
 //  Render all the sprites
 //
 void ParticleList::draw() {
@@ -151,9 +238,10 @@ void Emitter::update() {
 	}
 
 	
+	float fps = stepRate > 0 ? stepRate : ofGetFrameRate();
 	for (int i = 0; i < sys->particles.size(); i++) {
 		sys->particles[i].rot += .1;
-		sys->particles[i].pos += sys->particles[i].velocity / ofGetFrameRate();
+		sys->particles[i].pos += sys->particles[i].velocity / fps;
 	}
 	
 }
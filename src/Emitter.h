@@ -3,6 +3,7 @@
 #include "ofMain.h"
 #include "Shape.h"
 #include "Particle.h"
+#include "HeightField.h"
 
 //
 //  Manages all Sprites in a system.  You can create multiple systems
@@ -13,7 +14,20 @@ public:
 	void remove(int);
 	void update();
 	void draw();
+	void collide(const HeightField & ground);
 	vector<Particle> particles;
+
+	// ground collision response and per frame time budget
+	//
+	float restitution = 0.4;		// fraction of normal speed kept on bounce
+	float friction = 0.3;			// fraction of tangential speed lost on bounce
+	uint64_t collideBudgetMicros = 2000;
+
+private:
+	vector<uint64_t> collideOrder;	// (cell key << 32) | particle index at sort time, for the pass in progress
+	vector<uint32_t> collideSerial;	// particle serials at sort time, by that index
+	int collideStart = -1;			// where in collideOrder the pass resumes; -1: start a new pass
+	uint32_t nextSerial = 0;
 };
 
 
@@ -52,5 +66,6 @@ public:
 	float emitterVelocity;
 	float emitterAcceleration;
 	float emitterDamping;
+	float stepRate = 0;		// updates per second, 0 = the frame rate
 };
 
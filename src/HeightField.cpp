@@ -0,0 +1,194 @@
+#include "HeightField.h"
+
+//  Bake the grid.  "resolution" is the sample count along the longer side of
+//  the mesh bounds; the other side gets as many samples as keep the cells square.
+//
+void HeightField::bake(const ofMesh & mesh, int resolution) {
+	int n = mesh.getNumVertices();
+	if (n == 0 || resolution < 2) return;
+
+	glm::vec3 min = mesh.getVertex(0);
+	glm::vec3 max = min;
+	for (int i = 1; i < n; i++) {
+		min = glm::min(min, mesh.getVertex(i));
+		max = glm::max(max, mesh.getVertex(i));
+	}
+
+	float extent = std::max(max.x - min.x, max.z - min.z);
+	cellSize = extent > 0 ? extent / (resolution - 1) : 1;
+	origin = glm::vec3(min.x, 0, min.z);
+	width = (int)ceil((max.x - min.x) / cellSize) + 1;
+	depth = (int)ceil((max.z - min.z) / cellSize) + 1;
+	heights.assign(width * depth, -FLT_MAX);
+
+	// scan convert every triangle into the samples it covers
+	//
+	int numIndices = mesh.getNumIndices();
+	if (numIndices > 0) {
+		for (int i = 0; i + 2 < numIndices; i += 3) {
+			rasterize(mesh.getVertex(mesh.getIndex(i)), mesh.getVertex(mesh.getIndex(i + 1)),
+				mesh.getVertex(mesh.getIndex(i + 2)));
+		}
+	}
+	else {
+		for (int i = 0; i + 2 < n; i += 3) {
+			rasterize(mesh.getVertex(i), mesh.getVertex(i + 1), mesh.getVertex(i + 2));
+		}
+	}
+
+	// samples no triangle covered (holes, outside the terrain) fall to the
+	// lowest point of the mesh
+	//
+	for (int i = 0; i < heights.size(); i++) {
+		if (heights[i] == -FLT_MAX) heights[i] = min.y;
+	}
+
+	buildMips();
+}
+
+void HeightField::rasterize(const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c) {
+	float area = (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+	if (fabs(area) < 1e-12) return;		// vertical or degenerate in XZ
+
+	int i0 = std::max(0, (int)ceil((std::min(a.x, std::min(b.x, c.x)) - origin.x) / cellSize));
+	int i1 = std::min(width - 1, (int)floor((std::max(a.x, std::max(b.x, c.x)) - origin.x) / cellSize));
+	int j0 = std::max(0, (int)ceil((std::min(a.z, std::min(b.z, c.z)) - origin.z) / cellSize));
+	int j1 = std::min(depth - 1, (int)floor((std::max(a.z, std::max(b.z, c.z)) - origin.z) / cellSize));
+
+	const float eps = -1e-5;
+	for (int j = j0; j <= j1; j++) {
+		float z = origin.z + j * cellSize;
+		for (int i = i0; i <= i1; i++) {
+			float x = origin.x + i * cellSize;
+
+			// barycentric coordinates of (x, z) in the projected triangle
+			//
+			float u = ((b.x - x) * (c.z - z) - (c.x - x) * (b.z - z)) / area;
+			float v = ((c.x - x) * (a.z - z) - (a.x - x) * (c.z - z)) / area;
+			float w = 1 - u - v;
+			if (u < eps || v < eps || w < eps) continue;
+
+			float y = u * a.y + v * b.y + w * c.y;
+			float & h = heights[j * width + i];
+			if (y > h) h = y;
+		}
+	}
+}
+
+void HeightField::buildMips() {
+	minMip.clear();
+	maxMip.clear();
+	mipWidth.clear();
+	mipDepth.clear();
+
+	// level 0: bounds of the four corner samples of each cell.  Both
+	// interpolation modes stay within these.
+	//
+	int w = std::max(1, width - 1);
+	int d = std::max(1, depth - 1);
+	vector<float> lo(w * d), hi(w * d);
+	for (int j = 0; j < d; j++) {
+		for (int i = 0; i < w; i++) {
+			int i1 = std::min(i + 1, width - 1);
+			int j1 = std::min(j + 1, depth - 1);
+			float a = sample(i, j), b = sample(i1, j), c = sample(i, j1), e = sample(i1, j1);
+			lo[j * w + i] = std::min(std::min(a, b), std::min(c, e));
+			hi[j * w + i] = std::max(std::max(a, b), std::max(c, e));
+		}
+	}
+	minMip.push_back(lo);
+	maxMip.push_back(hi);
+	mipWidth.push_back(w);
+	mipDepth.push_back(d);
+
+	while (w > 1 || d > 1) {
+		int pw = w, pd = d;
+		const vector<float> & plo = minMip.back();
+		const vector<float> & phi = maxMip.back();
+		w = (w + 1) / 2;
+		d = (d + 1) / 2;
+		vector<float> nlo(w * d, FLT_MAX), nhi(w * d, -FLT_MAX);
+		for (int j = 0; j < pd; j++) {
+			for (int i = 0; i < pw; i++) {
+				int k = (j / 2) * w + (i / 2);
+				nlo[k] = std::min(nlo[k], plo[j * pw + i]);
+				nhi[k] = std::max(nhi[k], phi[j * pw + i]);
+			}
+		}
+		minMip.push_back(nlo);
+		maxMip.push_back(nhi);
+		mipWidth.push_back(w);
+		mipDepth.push_back(d);
+	}
+}
+
+bool HeightField::inside(float x, float z) const {
+	float fx = (x - origin.x) / cellSize;
+	float fz = (z - origin.z) / cellSize;
+	return fx >= 0 && fz >= 0 && fx <= width - 1 && fz <= depth - 1;
+}
+
+//  Interpolated ground height under (x, z).  Points off the grid clamp to the
+//  nearest edge.
+//
+float HeightField::heightAt(float x, float z) const {
+	if (heights.empty()) return 0;
+	float fx = glm::clamp((x - origin.x) / cellSize, 0.0f, (float)(width - 1));
+	float fz = glm::clamp((z - origin.z) / cellSize, 0.0f, (float)(depth - 1));
+	int i = std::min((int)fx, std::max(0, width - 2));
+	int j = std::min((int)fz, std::max(0, depth - 2));
+	float tx = fx - i;
+	float tz = fz - j;
+	int i1 = std::min(i + 1, width - 1);
+	int j1 = std::min(j + 1, depth - 1);
+
+	float h00 = sample(i, j), h10 = sample(i1, j), h01 = sample(i, j1), h11 = sample(i1, j1);
+	if (interpolation == TRIANGLE) {
+		if (tx > tz) return h00 + tx * (h10 - h00) + tz * (h11 - h10);
+		return h00 + tz * (h01 - h00) + tx * (h11 - h01);
+	}
+	float h0 = h00 + tx * (h10 - h00);
+	float h1 = h01 + tx * (h11 - h01);
+	return h0 + tz * (h1 - h0);
+}
+
+glm::vec3 HeightField::normalAt(float x, float z) const {
+	float dx = heightAt(x + cellSize, z) - heightAt(x - cellSize, z);
+	float dz = heightAt(x, z + cellSize) - heightAt(x, z - cellSize);
+	return glm::normalize(glm::vec3(-dx, 2 * cellSize, -dz));
+}
+
+//  Conservative bounds on the ground height over the rectangle [x0,x1] x [z0,z1].
+//  Picks the mip level at which the rectangle spans at most two cells on each
+//  axis, so the cost is four lookups whatever the footprint size.
+//
+bool HeightField::heightRange(float x0, float z0, float x1, float z1, float & lo, float & hi) const {
+	if (minMip.empty()) return false;
+	int w = mipWidth[0], d = mipDepth[0];
+	int i0 = glm::clamp((int)floor((x0 - origin.x) / cellSize), 0, w - 1);
+	int i1 = glm::clamp((int)floor((x1 - origin.x) / cellSize), 0, w - 1);
+	int j0 = glm::clamp((int)floor((z0 - origin.z) / cellSize), 0, d - 1);
+	int j1 = glm::clamp((int)floor((z1 - origin.z) / cellSize), 0, d - 1);
+
+	int level = 0;
+	while (level + 1 < minMip.size() && ((i1 >> level) - (i0 >> level) > 1 || (j1 >> level) - (j0 >> level) > 1)) {
+		level++;
+	}
+
+	lo = FLT_MAX;
+	hi = -FLT_MAX;
+	int lw = mipWidth[level];
+	for (int j = j0 >> level; j <= j1 >> level; j++) {
+		for (int i = i0 >> level; i <= i1 >> level; i++) {
+			lo = std::min(lo, minMip[level][j * lw + i]);
+			hi = std::max(hi, maxMip[level][j * lw + i]);
+		}
+	}
+	return true;
+}
+
+float HeightField::clearance(const Box & box) const {
+	float lo, hi;
+	if (!heightRange(box.min().x(), box.min().z(), box.max().x(), box.max().z(), lo, hi)) return 0;
+	return box.min().y() - hi;
+}
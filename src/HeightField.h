@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "box.h"
+
+//  2D height grid baked from a terrain mesh.  Answers "how high is the ground
+//  under (x, z)" in constant time, which is all the altitude telemetry and
+//  ground clearance checks need.  The octree stays in use for true 3D queries.
+//
+//  Samples sit on a square grid in the XZ plane.  Each sample stores the
+//  highest triangle above it, so overhangs resolve to their top surface.
+//  A min/max mipmap over the grid cells gives conservative height bounds for
+//  any rectangular footprint with a fixed number of lookups.
+//
+class HeightField {
+public:
+	enum Interpolation {
+		BILINEAR,	// bilinear blend of the four cell corners
+		TRIANGLE	// planar over the two triangles of each cell (split on the 00-11 diagonal)
+	};
+
+	void bake(const ofMesh & mesh, int resolution);
+	bool isBaked() const { return !heights.empty(); }
+
+	bool inside(float x, float z) const;
+	float heightAt(float x, float z) const;
+	glm::vec3 normalAt(float x, float z) const;
+	bool heightRange(float x0, float z0, float x1, float z1, float & lo, float & hi) const;
+
+	// height of p above the ground directly below it
+	//
+	float altitude(const glm::vec3 & p) const { return p.y - heightAt(p.x, p.z); }
+
+	// gap between the bottom of box and the highest sample of the grid cells
+	// under its footprint.  Relative to the sampled grid, not the mesh:
+	// never larger than the gap to the grid surface, but mesh peaks between
+	// samples can stand above the highest sample.
+	//
+	float clearance(const Box & box) const;
+
+	float sample(int i, int j) const { return heights[j * width + i]; }
+
+	Interpolation interpolation = BILINEAR;
+
+	int width = 0;			// samples along x
+	int depth = 0;			// samples along z
+	float cellSize = 1;
+	glm::vec3 origin;		// world position of sample (0, 0), y unused
+	vector<float> heights;
+
+	// mip level 0 holds one min/max pair per grid cell, each level above halves
+	// the cell count on both axes until a single cell covers the whole grid
+	//
+	vector<vector<float>> minMip, maxMip;
+	vector<int> mipWidth, mipDepth;
+
+private:
+	void rasterize(const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c);
+	void buildMips();
+};
@@ -0,0 +1,114 @@
+#include "InputRecorder.h"
+#include <fstream>
+
+static const char recordingMagic[4] = { 'L', 'R', 'E', 'C' };
+static const uint32_t recordingVersion = 1;
+
+static void writeVarint(ostream & out, uint32_t v) {
+	while (v >= 0x80) {
+		out.put((char)(v | 0x80));
+		v >>= 7;
+	}
+	out.put((char)v);
+}
+
+static bool readVarint(istream & in, uint32_t & v) {
+	v = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		int c = in.get();
+		if (c == EOF) return false;
+		v |= (uint32_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) return true;
+	}
+	return false;
+}
+
+void InputRecorder::startRecording(uint32_t seed, float tickRate) {
+	mode = RECORDING;
+	this->seed = seed;
+	this->tickRate = tickRate;
+	events.clear();
+	tick = numTicks = 0;
+}
+
+void InputRecorder::record(int key, bool pressed) {
+	if (mode != RECORDING) return;
+	InputEvent e;
+	e.tick = tick;
+	e.key = key;
+	e.pressed = pressed;
+	events.push_back(e);
+}
+
+bool InputRecorder::beginTick(vector<InputEvent> & eventsRtn) {
+	eventsRtn.clear();
+	if (mode == RECORDING) numTicks = tick + 1;
+	if (mode == REPLAYING) {
+		if (tick >= numTicks) return false;
+		while (nextEvent < events.size() && events[nextEvent].tick == tick) {
+			eventsRtn.push_back(events[nextEvent++]);
+		}
+	}
+	tick++;
+	return true;
+}
+
+bool InputRecorder::save(const string & path) const {
+	ofstream out(path, ios::binary);
+	if (!out) return false;
+	uint32_t numEvents = events.size();
+	out.write(recordingMagic, sizeof(recordingMagic));
+	out.write((const char *)&recordingVersion, sizeof(recordingVersion));
+	out.write((const char *)&seed, sizeof(seed));
+	out.write((const char *)&tickRate, sizeof(tickRate));
+	out.write((const char *)&numTicks, sizeof(numTicks));
+	out.write((const char *)&numEvents, sizeof(numEvents));
+	uint32_t last = 0;
+	for (const InputEvent & e : events) {
+		writeVarint(out, e.tick - last);
+		writeVarint(out, (uint32_t)e.key * 2 + (e.pressed ? 1 : 0));
+		last = e.tick;
+	}
+	return (bool)out;
+}
+
+bool InputRecorder::startReplay(const string & path) {
+	ifstream in(path, ios::binary);
+	char magic[4];
+	uint32_t version = 0, numEvents = 0;
+	in.read(magic, sizeof(magic));
+	in.read((char *)&version, sizeof(version));
+	in.read((char *)&seed, sizeof(seed));
+	in.read((char *)&tickRate, sizeof(tickRate));
+	in.read((char *)&numTicks, sizeof(numTicks));
+	in.read((char *)&numEvents, sizeof(numEvents));
+	if (!in || memcmp(magic, recordingMagic, sizeof(magic)) != 0 || version != recordingVersion || tickRate <= 0) {
+		return false;
+	}
+
+	// every event is two varints of at least a byte each, so a count the
+	// rest of the file can't hold is a corrupt header
+	//
+	uint64_t at = in.tellg();
+	in.seekg(0, ios::end);
+	uint64_t remaining = (uint64_t)in.tellg() - at;
+	in.seekg(at);
+	if (!in || numEvents > remaining / 2) return false;
+	events.resize(numEvents);
+	uint32_t last = 0;
+	for (InputEvent & e : events) {
+		uint32_t delta, key;
+		if (!readVarint(in, delta) || !readVarint(in, key)) {
+			events.clear();
+			return false;
+		}
+		e.tick = last + delta;
+		e.key = (int)(key >> 1);
+		e.pressed = key & 1;
+		last = e.tick;
+	}
+	mode = REPLAYING;
+	tick = 0;
+	nextEvent = 0;
+	return true;
+}
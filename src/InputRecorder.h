@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  Keyboard input recorded per simulation tick, for replaying a descent
+//  exactly (performance regression runs).
+//
+//  A recording holds the RNG seed, the fixed tick rate the simulation ran at
+//  and every key press and release tagged with the tick it arrived before.
+//  On disk (.lrec) it is a small header followed by the events as varints:
+//  tick delta, then key * 2 + (pressed ? 1 : 0).
+//
+struct InputEvent {
+	uint32_t tick;
+	int key;
+	bool pressed;
+};
+
+class InputRecorder {
+public:
+	enum Mode { LIVE, RECORDING, REPLAYING };
+
+	void startRecording(uint32_t seed, float tickRate);
+	bool save(const string & path) const;
+	bool startReplay(const string & path);
+
+	// called from keyPressed/keyReleased while recording
+	//
+	void record(int key, bool pressed);
+
+	//  beginTick:  start the next tick.  When replaying, returns the events
+	//              to apply before it; false once the recording is used up.
+	//
+	bool beginTick(vector<InputEvent> & eventsRtn);
+
+	Mode mode = LIVE;
+	uint32_t seed = 0;
+	float tickRate = 60;
+	uint32_t numTicks = 0;		// ticks recorded, or in the replay
+	uint32_t tick = 0;			// current tick
+
+private:
+	vector<InputEvent> events;
+	size_t nextEvent = 0;
+};
@@ -0,0 +1,215 @@
+#include "LandingEstimator.h"
+
+void LandingEstimator::setup(const SpatialIndex *terrain, const HeightField *ground, const glm::vec3 & landerMin,
+	const glm::vec3 & landerMax, const vector<glm::vec3> & landingZones, float tickRate) {
+	this->terrain = terrain;
+	this->ground = ground;
+	this->landerMin = landerMin;
+	this->landerMax = landerMax;
+	this->landingZones = landingZones;
+	this->tickRate = tickRate;
+}
+
+//  height:  ground height under p, from the height field when it's baked and
+//           covers p, otherwise from a ray down through the terrain index
+//
+float LandingEstimator::height(const glm::vec3 & p, SpatialContext & context) const {
+	if (ground && ground->isBaked() && ground->inside(p.x, p.z)) return ground->heightAt(p.x, p.z);
+	Ray downRay(p, Vector3(0, -1, 0));
+	SpatialHit hit;
+	return terrain->raycast(downRay, context, hit) ? hit.point.y : -FLT_MAX;
+}
+
+//  rollout:  fly landing number "index" of the scenario until it touches
+//            down or times out.  Its start, pilot and turbulence come from a
+//            generator seeded with (scenario seed, index) only.
+//
+void LandingEstimator::rollout(Simulation & sim, const LandingScenario & scenario, int index,
+	SpatialContext & context, LandingTotals & totalsRtn) {
+	std::seed_seq seq { scenario.seed, (uint32_t)index };
+	std::mt19937 rng(seq);
+	auto uniform = [&rng](float a, float b) { return std::uniform_real_distribution<float>(a, b)(rng); };
+
+	float angle = uniform(0, TWO_PI);
+	float r = scenario.startRadius * sqrt(uniform(0, 1));
+	float dh = scenario.startHeightRange;
+	float dv = scenario.startVelocityRange;
+	glm::vec3 start = scenario.start + glm::vec3(r * cos(angle), uniform(-dh, dh), r * sin(angle));
+	glm::vec3 velocity = scenario.startVelocity + glm::vec3(uniform(-dv, dv), uniform(-dv, dv), uniform(-dv, dv));
+	float j = scenario.pilotJitter;
+	Pilot pilot = scenario.pilot;
+	pilot.margin *= 1 + uniform(-j, j);
+	pilot.descentSpeed *= 1 + uniform(-j, j);
+	pilot.flareHeight *= 1 + uniform(-j, j);
+	pilot.steerGain *= 1 + uniform(-j, j);
+	pilot.maxLateralSpeed *= 1 + uniform(-j, j);
+
+	sim.seed(rng());
+	sim.restart(start, velocity);
+	int touchdowns = sim.touchdowns();
+	const LanderParams & params = scenario.params;
+	float brake = params.thrust - params.gravity;
+	int maxTicks = scenario.maxSeconds * tickRate;
+	bool done = false;
+	for (int tick = 0; tick < maxTicks && !done; tick++) {
+		glm::vec3 p = sim.position();
+		glm::vec3 v = sim.velocity();
+
+		// brake when the distance needed to slow to descentSpeed (with
+		// margin) reaches the height of the lander's feet above flareHeight
+		//
+		float h = p.y + landerMin.y - height(p, context);
+		float sink = -v.y;
+		bool burn = false;
+		if (sink > pilot.descentSpeed) {
+			float stop = brake > 0 ? (sink * sink - pilot.descentSpeed * pilot.descentSpeed) / (2 * brake) : FLT_MAX;
+			burn = stop * pilot.margin >= h - pilot.flareHeight;
+		}
+
+		// steer toward the nearest landing zone
+		//
+		glm::vec2 offset(0);
+		float nearest = FLT_MAX;
+		for (const glm::vec3 & zone : landingZones) {
+			glm::vec2 d(zone.x - p.x, zone.z - p.z);
+			float d2 = glm::dot(d, d);
+			if (d2 < nearest) {
+				nearest = d2;
+				offset = d;
+			}
+		}
+		glm::vec2 want = glm::clamp(offset * pilot.steerGain, -pilot.maxLateralSpeed, pilot.maxLateralSpeed);
+		const float deadband = 0.1;
+		int x = v.x < want.x - deadband ? 1 : (v.x > want.x + deadband ? -1 : 0);
+		int z = v.z < want.y - deadband ? 1 : (v.z > want.y + deadband ? -1 : 0);
+
+		sim.setControls(burn, x, z);
+		sim.step();
+		done = sim.crashed() || sim.landed() || sim.touchdowns() > touchdowns;
+	}
+
+	float fuel = params.fuel - sim.fuelLeft();
+	totalsRtn.fuel += fuel;
+	totalsRtn.fuel2 += fuel * fuel;
+	if (!done) {
+		totalsRtn.timedOut++;
+		return;
+	}
+	if (sim.crashed()) totalsRtn.crashed++;
+	else if (sim.landed()) totalsRtn.landed++;
+	else totalsRtn.missed++;
+	float speed = sim.impactSpeed();
+	totalsRtn.speed += speed;
+	totalsRtn.speed2 += speed * speed;
+	totalsRtn.touchdowns++;
+}
+
+//  worker:  rollouts are taken from the shared counter in small batches
+//
+void LandingEstimator::worker(const LandingScenario & scenario, std::atomic<int> & next, LandingTotals & totalsRtn) {
+	Simulation sim;
+	sim.setHeadless(true);
+	sim.params = scenario.params;
+	sim.setup(terrain, NULL, ground, landerMin, landerMax, scenario.start, landingZones,
+		scenario.params.landingZoneSize, tickRate);
+	std::unique_ptr<SpatialContext> context = terrain->newContext();
+	LandingTotals totals;
+	const int batch = 16;
+	int first;
+	while ((first = next.fetch_add(batch)) < scenario.rollouts) {
+		int last = std::min(first + batch, scenario.rollouts);
+		for (int i = first; i < last; i++) rollout(sim, scenario, i, *context, totals);
+	}
+	totalsRtn = totals;
+}
+
+// mean and normal 95% interval from a sum and sum of squares
+//
+static Estimate meanEstimate(double sum, double sum2, int n) {
+	Estimate e;
+	e.samples = n;
+	if (n == 0) return e;
+	e.mean = sum / n;
+	double var = n > 1 ? std::max(0.0, (sum2 - n * e.mean * e.mean) / (n - 1)) : 0;
+	double half = 1.96 * sqrt(var / n);
+	e.lo = e.mean - half;
+	e.hi = e.mean + half;
+	return e;
+}
+
+// Wilson score 95% interval for k successes out of n
+//
+static Estimate rateEstimate(int k, int n) {
+	Estimate e;
+	e.samples = n;
+	if (n == 0) return e;
+	const double z = 1.96;
+	double p = (double)k / n;
+	double denom = 1 + z * z / n;
+	double center = (p + z * z / (2 * n)) / denom;
+	double half = z * sqrt(p * (1 - p) / n + z * z / (4.0 * n * n)) / denom;
+	e.mean = p;
+	e.lo = center - half;
+	e.hi = center + half;
+	return e;
+}
+
+LandingEstimate LandingEstimator::run(const LandingScenario & scenario, int numThreads) {
+	if (terrain == NULL) {
+		cout << "Error: landing estimator has no terrain" << endl;
+		return LandingEstimate();
+	}
+	int n = numThreads > 0 ? numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+	vector<LandingTotals> totals(n);
+	std::atomic<int> next { 0 };
+	uint64_t start = ofGetElapsedTimeMicros();
+	vector<std::thread> threads;
+	for (int i = 0; i < n; i++) {
+		threads.emplace_back(&LandingEstimator::worker, this, std::cref(scenario), std::ref(next), std::ref(totals[i]));
+	}
+	for (auto & t : threads) t.join();
+	return summarize(scenario, totals, (ofGetElapsedTimeMicros() - start) / 1e6);
+}
+
+LandingEstimate LandingEstimator::summarize(const LandingScenario & scenario, const vector<LandingTotals> & totals, double seconds) {
+	LandingEstimate estimate;
+	estimate.seconds = seconds;
+	LandingTotals sum;
+	for (const LandingTotals & t : totals) {
+		sum.landed += t.landed;
+		sum.crashed += t.crashed;
+		sum.missed += t.missed;
+		sum.timedOut += t.timedOut;
+		sum.fuel += t.fuel;
+		sum.fuel2 += t.fuel2;
+		sum.speed += t.speed;
+		sum.speed2 += t.speed2;
+		sum.touchdowns += t.touchdowns;
+	}
+	estimate.rollouts = scenario.rollouts;
+	estimate.landed = sum.landed;
+	estimate.crashed = sum.crashed;
+	estimate.missed = sum.missed;
+	estimate.timedOut = sum.timedOut;
+	estimate.successRate = rateEstimate(sum.landed, scenario.rollouts);
+	estimate.fuelUsed = meanEstimate(sum.fuel, sum.fuel2, scenario.rollouts);
+	estimate.touchdownSpeed = meanEstimate(sum.speed, sum.speed2, sum.touchdowns);
+	estimate.threads = totals.size();
+	estimate.rolloutsPerSecond = estimate.seconds > 0 ? scenario.rollouts / estimate.seconds : 0;
+	return estimate;
+}
+
+void LandingEstimator::print(const LandingScenario & scenario, const LandingEstimate & e) {
+	const LanderParams & p = scenario.params;
+	cout << "landing estimate: gravity " << p.gravity << ", thrust " << p.thrust << ", fuel " << p.fuel
+		<< ", zone " << p.landingZoneSize << endl;
+	cout << "  " << e.rollouts << " rollouts on " << e.threads << " threads in " << e.seconds << " s: "
+		<< e.rolloutsPerSecond << " rollouts/s" << endl;
+	cout << "  landed " << e.landed << ", crashed " << e.crashed << ", missed " << e.missed
+		<< ", timed out " << e.timedOut << endl;
+	cout << "  success rate    " << e.successRate.mean * 100 << "% [" << e.successRate.lo * 100 << ", "
+		<< e.successRate.hi * 100 << "]" << endl;
+	cout << "  fuel used       " << e.fuelUsed.mean << " s [" << e.fuelUsed.lo << ", " << e.fuelUsed.hi << "]" << endl;
+	cout << "  touchdown speed " << e.touchdownSpeed.mean << " [" << e.touchdownSpeed.lo << ", "
+		<< e.touchdownSpeed.hi << "] over " << e.touchdownSpeed.samples << " touchdowns" << endl;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Simulation.h"
+
+//  Autopilot flown by the rollouts.  It brakes once the distance needed to
+//  slow to descentSpeed (times margin) reaches its height above flareHeight,
+//  and steers toward the nearest landing zone at a speed proportional to the
+//  distance left.
+//
+struct Pilot {
+	float margin = 1.3;
+	float descentSpeed = 0.6;		// units/s to settle at near the ground
+	float flareHeight = 3;			// height to be down to descentSpeed by
+	float steerGain = 0.1;			// lateral units/s per unit of distance
+	float maxLateralSpeed = 3;
+};
+
+//  A distribution of landings: the physics to test, where and how fast the
+//  lander starts and how it's flown.  Each rollout draws a start uniformly
+//  from the ranges and scales every pilot setting by 1 +- pilotJitter.
+//
+struct LandingScenario {
+	LanderParams params;
+	glm::vec3 start;
+	float startRadius = 30;			// horizontal offset, uniform over the disc
+	float startHeightRange = 10;	// +- height offset
+	glm::vec3 startVelocity;		// units/s
+	float startVelocityRange = 1;	// +- per axis
+	Pilot pilot;
+	float pilotJitter = 0.25;
+	float maxSeconds = 90;			// rollouts still flying then time out
+	int rollouts = 10000;
+	uint32_t seed = 1;				// rollout i is the same for any thread count
+};
+
+//  Sample mean with a 95% confidence interval [lo, hi]
+//
+struct Estimate {
+	double mean = 0, lo = 0, hi = 0;
+	int samples = 0;
+};
+
+struct LandingEstimate {
+	int rollouts = 0;
+	int landed = 0;					// soft touchdown in a landing zone
+	int crashed = 0;				// touchdown faster than crashSpeed
+	int missed = 0;					// any other touchdown (outside a zone or too fast)
+	int timedOut = 0;
+	Estimate successRate;			// Wilson score interval
+	Estimate fuelUsed;				// seconds of thrust, all rollouts
+	Estimate touchdownSpeed;		// units/s, rollouts that touched down
+	int threads = 0;
+	double seconds = 0;
+	double rolloutsPerSecond = 0;
+};
+
+//  Raw counts and sums from one worker's share of the rollouts.  Plain data,
+//  so workers in other processes can fill it in shared memory.
+//
+struct LandingTotals {
+	int landed = 0, crashed = 0, missed = 0, timedOut = 0;
+	double fuel = 0, fuel2 = 0;
+	double speed = 0, speed2 = 0;
+	int touchdowns = 0;
+};
+
+//  Batch evaluator for tuning LanderParams.  Flies many headless Simulation
+//  rollouts of a LandingScenario in parallel (one Simulation per thread, all
+//  sharing the read-only terrain index) and reports landing outcomes with
+//  confidence intervals.  Rollouts per second is the throughput figure.
+//
+//  The terrain is any SpatialIndex: the game's octree (with its height field
+//  for the autopilot's altimeter), or a CompactOctree image, which is all
+//  SimFarm workers have.
+//
+class LandingEstimator {
+public:
+	void setup(const SpatialIndex *terrain, const HeightField *ground, const glm::vec3 & landerMin,
+		const glm::vec3 & landerMax, const vector<glm::vec3> & landingZones, float tickRate = 60);
+	LandingEstimate run(const LandingScenario & scenario, int numThreads = 0);	// 0: all cores
+	static void print(const LandingScenario & scenario, const LandingEstimate & estimate);
+
+	//  worker:  one headless Simulation flying rollouts taken from "next" until
+	//           the scenario is done.  run() starts one per thread; SimFarm one
+	//           per process, with "next" and the totals in shared memory.
+	//
+	void worker(const LandingScenario & scenario, std::atomic<int> & next, LandingTotals & totalsRtn);
+	static LandingEstimate summarize(const LandingScenario & scenario, const vector<LandingTotals> & totals, double seconds);
+
+private:
+	void rollout(Simulation & sim, const LandingScenario & scenario, int index, SpatialContext & context, LandingTotals & totalsRtn);
+	float height(const glm::vec3 & p, SpatialContext & context) const;
+
+	const SpatialIndex *terrain = NULL;
+	const HeightField *ground = NULL;
+	glm::vec3 landerMin, landerMax;
+	vector<glm::vec3> landingZones;
+	float tickRate = 60;
+};
@@ -0,0 +1,235 @@
+#include "LandingMap.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// f(begin, end) over [0, n) split into "threads" contiguous ranges, the first
+// on the calling thread
+//
+template <class F> void parallelRanges(int n, int threads, F f) {
+	threads = std::max(1, std::min(threads, n));
+	vector<std::thread> workers;
+	for (int t = 1; t < threads; t++) workers.push_back(std::thread(f, n * t / threads, n * (t + 1) / threads));
+	f(0, n / threads);
+	for (auto & w : workers) w.join();
+}
+
+}
+
+void LandingMap::build(const HeightField & ground, float siteSize, int numThreads) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	this->ground = &ground;
+	width = std::max(0, ground.width - 1);
+	depth = std::max(0, ground.depth - 1);
+	numSites = 0;
+	nearest.clear();
+	if (!ground.isBaked() || width == 0 || depth == 0) return;
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	// slope and roughness of each cell from the least squares plane through
+	// its corners: the gradient averages the two edge differences on each
+	// axis, and all four corners sit the same distance off the plane
+	//
+	int n = width * depth;
+	float cell = ground.cellSize;
+	slope.resize(n);
+	roughness.resize(n);
+	vector<uint8_t> flat(n);
+	parallelRanges(depth, numThreads, [&](int j0, int j1) {
+		for (int j = j0; j < j1; j++) {
+			for (int i = 0; i < width; i++) {
+				float a = ground.sample(i, j), b = ground.sample(i + 1, j);
+				float c = ground.sample(i, j + 1), e = ground.sample(i + 1, j + 1);
+				float gx = (b - a + e - c) / (2 * cell);
+				float gz = (c - a + e - b) / (2 * cell);
+				int k = j * width + i;
+				slope[k] = sqrt(gx * gx + gz * gz);
+				roughness[k] = fabs(a - b - c + e) / 4;
+				flat[k] = slope[k] <= maxSlope && roughness[k] <= maxRoughness;
+			}
+		}
+	});
+
+	// summed area tables: prefix sums along the rows, then down the columns
+	//
+	int w1 = width + 1;
+	unflatSum.assign(w1 * (depth + 1), 0);
+	slopeSum.assign(w1 * (depth + 1), 0);
+	parallelRanges(depth, numThreads, [&](int j0, int j1) {
+		for (int j = j0; j < j1; j++) {
+			int count = 0;
+			double sum = 0;
+			for (int i = 0; i < width; i++) {
+				count += !flat[j * width + i];
+				sum += slope[j * width + i];
+				unflatSum[(j + 1) * w1 + i + 1] = count;
+				slopeSum[(j + 1) * w1 + i + 1] = sum;
+			}
+		}
+	});
+	parallelRanges(width, numThreads, [&](int i0, int i1) {
+		for (int j = 2; j <= depth; j++) {
+			for (int i = i0 + 1; i <= i1; i++) {
+				unflatSum[j * w1 + i] += unflatSum[(j - 1) * w1 + i];
+				slopeSum[j * w1 + i] += slopeSum[(j - 1) * w1 + i];
+			}
+		}
+	});
+
+	// sites, and the nearest site in each cell's own row
+	//
+	siteCells = std::max(1, (int)ceil(siteSize / cell));
+	int half = (siteCells - 1) / 2;
+	vector<int> rowSite(n);
+	std::atomic<int> sites { 0 };
+	parallelRanges(depth, numThreads, [&](int j0, int j1) {
+		vector<uint8_t> site(width);
+		int count = 0;
+		for (int j = j0; j < j1; j++) {
+			for (int i = 0; i < width; i++) {
+				int si = i - half, sj = j - half;
+				site[i] = si >= 0 && sj >= 0 && si + siteCells <= width && sj + siteCells <= depth &&
+					unflatCells(si, sj, si + siteCells - 1, sj + siteCells - 1) == 0;
+				count += site[i];
+			}
+			int *row = &rowSite[j * width];
+			int last = -1;
+			for (int i = 0; i < width; i++) {
+				if (site[i]) last = i;
+				row[i] = last;
+			}
+			last = -1;
+			for (int i = width - 1; i >= 0; i--) {
+				if (site[i]) last = i;
+				if (last != -1 && (row[i] == -1 || last - i < i - row[i])) row[i] = last;
+			}
+		}
+		sites += count;
+	});
+	numSites = sites;
+
+	// down each column: lower envelope of the parabolas (j - j')^2 + dx(j')^2,
+	// dx(j') being the distance to the nearest site in row j' (Felzenszwalb
+	// and Huttenlocher's distance transform, keeping the argmin)
+	//
+	nearest.assign(n, -1);
+	parallelRanges(width, numThreads, [&](int i0, int i1) {
+		vector<int> v(depth);
+		vector<float> f(depth), bound(depth + 1);
+		for (int i = i0; i < i1; i++) {
+			int k = -1;
+			for (int q = 0; q < depth; q++) {
+				int col = rowSite[q * width + i];
+				if (col == -1) continue;
+				f[q] = (float)(i - col) * (i - col);
+				float s = -FLT_MAX;
+				while (k >= 0) {
+					int r = v[k];
+					s = ((f[q] + (float)q * q) - (f[r] + (float)r * r)) / (2.0f * (q - r));
+					if (s > bound[k]) break;
+					k--;
+				}
+				if (k < 0) s = -FLT_MAX;
+				k++;
+				v[k] = q;
+				bound[k] = s;
+				bound[k + 1] = FLT_MAX;
+			}
+			if (k < 0) continue;
+			int m = 0;
+			for (int q = 0; q < depth; q++) {
+				while (bound[m + 1] < q) m++;
+				nearest[q * width + i] = v[m] * width + rowSite[v[m] * width + i];
+			}
+		}
+	});
+	buildMicros = ofGetElapsedTimeMicros() - start;
+}
+
+//  cell rectangle covering [x0,x1] x [z0,z1]; false if any of it is off the grid
+//
+bool LandingMap::cellRange(float x0, float z0, float x1, float z1, int & i0, int & j0, int & i1, int & j1) const {
+	if (!isBuilt()) return false;
+	float cell = ground->cellSize;
+	i0 = (int)floor((x0 - ground->origin.x) / cell);
+	i1 = (int)floor((x1 - ground->origin.x) / cell);
+	j0 = (int)floor((z0 - ground->origin.z) / cell);
+	j1 = (int)floor((z1 - ground->origin.z) / cell);
+	return i0 >= 0 && j0 >= 0 && i1 < width && j1 < depth && i0 <= i1 && j0 <= j1;
+}
+
+int LandingMap::unflatCells(int i0, int j0, int i1, int j1) const {
+	int w1 = width + 1;
+	return unflatSum[(j1 + 1) * w1 + i1 + 1] - unflatSum[j0 * w1 + i1 + 1] - unflatSum[(j1 + 1) * w1 + i0] + unflatSum[j0 * w1 + i0];
+}
+
+bool LandingMap::landable(float x0, float z0, float x1, float z1) const {
+	int i0, j0, i1, j1;
+	if (!cellRange(x0, z0, x1, z1, i0, j0, i1, j1)) return false;
+	return unflatCells(i0, j0, i1, j1) == 0;
+}
+
+bool LandingMap::landable(const Box & footprint) const {
+	return landable(footprint.min().x(), footprint.min().z(), footprint.max().x(), footprint.max().z());
+}
+
+float LandingMap::meanSlope(float x0, float z0, float x1, float z1) const {
+	int i0, j0, i1, j1;
+	if (!cellRange(x0, z0, x1, z1, i0, j0, i1, j1)) return -1;
+	int w1 = width + 1;
+	double sum = slopeSum[(j1 + 1) * w1 + i1 + 1] - slopeSum[j0 * w1 + i1 + 1] - slopeSum[(j1 + 1) * w1 + i0] + slopeSum[j0 * w1 + i0];
+	return sum / ((i1 - i0 + 1) * (j1 - j0 + 1));
+}
+
+glm::vec3 LandingMap::cellCenter(int cell) const {
+	float x = ground->origin.x + (cell % width + 0.5f) * ground->cellSize;
+	float z = ground->origin.z + (cell / width + 0.5f) * ground->cellSize;
+	return glm::vec3(x, ground->heightAt(x, z), z);
+}
+
+//  Nearest site to p in the XZ plane.  Points off the grid use the nearest
+//  edge cell.
+//
+bool LandingMap::nearestSite(const glm::vec3 & p, glm::vec3 & siteRtn) const {
+	if (!isBuilt()) return false;
+	int i = glm::clamp((int)floor((p.x - ground->origin.x) / ground->cellSize), 0, width - 1);
+	int j = glm::clamp((int)floor((p.z - ground->origin.z) / ground->cellSize), 0, depth - 1);
+	int site = nearest[j * width + i];
+	if (site == -1) return false;
+	siteRtn = cellCenter(site);
+	return true;
+}
+
+int LandingMap::pickSites(int count, float spacing, vector<glm::vec3> & sitesRtn) const {
+	if (!isBuilt() || numSites == 0) return 0;
+	int half = (siteCells - 1) / 2;
+	int w1 = width + 1;
+	vector<pair<double, int>> candidates;
+	candidates.reserve(numSites);
+	for (int j = half; j + siteCells - half <= depth; j++) {
+		for (int i = half; i + siteCells - half <= width; i++) {
+			int cell = j * width + i;
+			if (nearest[cell] != cell) continue;
+			int i0 = i - half, j0 = j - half, i1 = i0 + siteCells, j1 = j0 + siteCells;
+			candidates.push_back(make_pair(slopeSum[j1 * w1 + i1] - slopeSum[j0 * w1 + i1] - slopeSum[j1 * w1 + i0] +
+				slopeSum[j0 * w1 + i0], cell));
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	int picked = 0;
+	float spacing2 = spacing * spacing;
+	for (auto & c : candidates) {
+		glm::vec3 p = cellCenter(c.second);
+		bool clear = true;
+		for (int k = sitesRtn.size() - picked; k < sitesRtn.size() && clear; k++) {
+			float dx = sitesRtn[k].x - p.x, dz = sitesRtn[k].z - p.z;
+			clear = dx * dx + dz * dz >= spacing2;
+		}
+		if (!clear) continue;
+		sitesRtn.push_back(p);
+		if (++picked == count) break;
+	}
+	return picked;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ofMain.h"
+#include "HeightField.h"
+
+//  Slope and flatness of every height field cell, indexed for landing queries.
+//
+//  A cell is flat when the plane through its four corner samples is no
+//  steeper than maxSlope and no corner is more than maxRoughness off it.
+//  Summed area tables over the non-flat cells and the slopes answer "is this
+//  footprint landable" and "how steep is it on average" with four lookups.
+//
+//  A landing site is a cell at the center of a flat square at least siteSize
+//  across.  Every cell also stores its nearest site (exact Euclidean distance
+//  transform over the grid), so "nearest safe site" is a single lookup.
+//
+//  build() runs after the height field is baked; every pass is split by rows
+//  (or columns) across numThreads threads.
+//
+class LandingMap {
+public:
+	void build(const HeightField & ground, float siteSize, int numThreads = 0);
+	bool isBuilt() const { return !nearest.empty(); }
+
+	bool landable(float x0, float z0, float x1, float z1) const;
+	bool landable(const Box & footprint) const;
+	float meanSlope(float x0, float z0, float x1, float z1) const;		// rise over run, -1 off the grid
+	bool nearestSite(const glm::vec3 & p, glm::vec3 & siteRtn) const;
+
+	// up to "count" sites at least "spacing" apart, flattest first
+	//
+	int pickSites(int count, float spacing, vector<glm::vec3> & sitesRtn) const;
+
+	float maxSlope = 0.15;			// rise over run (about 8.5 degrees)
+	float maxRoughness = 0.1;
+
+	int width = 0, depth = 0;		// cells
+	int numSites = 0;
+	int siteSize() const { return siteCells; }	// side of a site, in cells
+	uint64_t buildMicros = 0;		// time taken by the last build()
+	vector<float> slope, roughness;
+
+private:
+	bool cellRange(float x0, float z0, float x1, float z1, int & i0, int & j0, int & i1, int & j1) const;
+	int unflatCells(int i0, int j0, int i1, int j1) const;
+	glm::vec3 cellCenter(int cell) const;
+
+	const HeightField *ground = NULL;
+	int siteCells = 1;				// side of a site's flat square, in cells
+	vector<int> unflatSum;			// (width + 1) x (depth + 1) summed area tables
+	vector<double> slopeSum;
+	vector<int> nearest;			// per cell: nearest site cell, -1 if there are none
+};
@@ -0,0 +1,170 @@
+#include "LooseOctree.h"
+
+//  Cover "world" with a cube and allocate all levels.  Level L has 2^L cells
+//  per axis; depth 6 is about 300k nodes.
+//
+void LooseOctree::setup(const Box & world, int d) {
+	depth = std::max(0, std::min(d, 8));
+	Vector3 extent = world.max() - world.min();
+	worldSize = std::max(extent.x(), std::max(extent.y(), extent.z()));
+	if (worldSize <= 0) worldSize = 1;
+	origin = world.min();
+
+	levelOffset.clear();
+	int total = 0;
+	for (int level = 0; level <= depth; level++) {
+		levelOffset.push_back(total);
+		total += 1 << (3 * level);
+	}
+	nodes.assign(total, Node());
+	nodeLevel.resize(total);
+	for (int level = 0; level <= depth; level++) {
+		int end = level < depth ? levelOffset[level + 1] : total;
+		for (int i = levelOffset[level]; i < end; i++) nodeLevel[i] = level;
+	}
+	entities.clear();
+	freeHandle = -1;
+	numEntities = 0;
+}
+
+void LooseOctree::clear() {
+	for (int i = 0; i < nodes.size(); i++) nodes[i] = Node();
+	entities.clear();
+	freeHandle = -1;
+	numEntities = 0;
+}
+
+int LooseOctree::nodeIndex(int level, int ix, int iy, int iz) const {
+	int n = 1 << level;
+	return levelOffset[level] + (iz * n + iy) * n + ix;
+}
+
+//  Deepest node whose cell is at least as large as the object and contains
+//  its center.  Objects centered outside the world go in the root.
+//
+int LooseOctree::nodeFor(const Box & bounds) const {
+	Vector3 c = bounds.center() - origin;
+	if (c.x() < 0 || c.y() < 0 || c.z() < 0 || c.x() >= worldSize || c.y() >= worldSize || c.z() >= worldSize) {
+		return 0;
+	}
+
+	Vector3 extent = bounds.max() - bounds.min();
+	float s = std::max(extent.x(), std::max(extent.y(), extent.z()));
+	int level = 0;
+	while (level < depth && s <= worldSize / (1 << (level + 1))) level++;
+
+	int n = 1 << level;
+	float cell = worldSize / n;
+	int ix = std::max(0, std::min(n - 1, (int)floor(c.x() / cell)));
+	int iy = std::max(0, std::min(n - 1, (int)floor(c.y() / cell)));
+	int iz = std::max(0, std::min(n - 1, (int)floor(c.z() / cell)));
+	return nodeIndex(level, ix, iy, iz);
+}
+
+// add delta to the subtree counts of node and all its ancestors
+//
+void LooseOctree::adjustCounts(int node, int delta) {
+	int level = nodeLevel[node];
+	int i = node - levelOffset[level];
+	int n = 1 << level;
+	int ix = i % n, iy = (i / n) % n, iz = i / (n * n);
+	for (; level >= 0; level--) {
+		nodes[nodeIndex(level, ix, iy, iz)].count += delta;
+		ix >>= 1; iy >>= 1; iz >>= 1;
+	}
+}
+
+void LooseOctree::link(int handle, int node) {
+	Entity & e = entities[handle];
+	e.node = node;
+	e.prev = -1;
+	e.next = nodes[node].head;
+	if (e.next != -1) entities[e.next].prev = handle;
+	nodes[node].head = handle;
+	adjustCounts(node, 1);
+}
+
+void LooseOctree::unlink(int handle) {
+	Entity & e = entities[handle];
+	if (e.prev != -1) entities[e.prev].next = e.next;
+	else nodes[e.node].head = e.next;
+	if (e.next != -1) entities[e.next].prev = e.prev;
+	adjustCounts(e.node, -1);
+}
+
+int LooseOctree::insert(const Box & bounds, int userData) {
+	int handle;
+	if (freeHandle != -1) {
+		handle = freeHandle;
+		freeHandle = entities[handle].next;
+	}
+	else {
+		handle = entities.size();
+		entities.push_back(Entity());
+	}
+	entities[handle].bounds = bounds;
+	entities[handle].userData = userData;
+	link(handle, nodeFor(bounds));
+	numEntities++;
+	return handle;
+}
+
+void LooseOctree::remove(int handle) {
+	if (handle < 0 || handle >= entities.size() || entities[handle].node == -1) return;
+	unlink(handle);
+	entities[handle].node = -1;
+	entities[handle].next = freeHandle;
+	freeHandle = handle;
+	numEntities--;
+}
+
+void LooseOctree::update(int handle, const Box & bounds) {
+	if (handle < 0 || handle >= entities.size() || entities[handle].node == -1) return;
+	Entity & e = entities[handle];
+	e.bounds = bounds;
+	int node = nodeFor(bounds);
+	if (node == e.node) return;
+	unlink(handle);
+	link(handle, node);
+}
+
+void LooseOctree::query(const Box & box, int level, int ix, int iy, int iz, int skip, vector<int> & handlesRtn) const {
+	const Node & node = nodes[nodeIndex(level, ix, iy, iz)];
+	if (node.count == 0) return;
+
+	// loose bounds: the cell grown by half a cell on every side
+	//
+	float cell = worldSize / (1 << level);
+	Vector3 lo = origin + Vector3(ix - 0.5f, iy - 0.5f, iz - 0.5f) * cell;
+	Vector3 hi = lo + Vector3(2, 2, 2) * cell;
+	if (level > 0 && !Box(lo, hi).overlap(box)) return;
+
+	for (int h = node.head; h != -1; h = entities[h].next) {
+		if (h > skip && entities[h].bounds.overlap(box)) handlesRtn.push_back(h);
+	}
+	if (level == depth) return;
+	for (int c = 0; c < 8; c++) {
+		query(box, level + 1, ix * 2 + (c & 1), iy * 2 + ((c >> 1) & 1), iz * 2 + (c >> 2), skip, handlesRtn);
+	}
+}
+
+//  overlap:  handles of all objects whose bounds overlap box.  Returns count found.
+//
+int LooseOctree::overlap(const Box & box, vector<int> & handlesRtn) const {
+	int count = handlesRtn.size();
+	if (!nodes.empty()) query(box, 0, 0, 0, 0, -1, handlesRtn);
+	return handlesRtn.size() - count;
+}
+
+//  pairs:  every overlapping pair (a, b) with a < b, each reported once.
+//
+int LooseOctree::pairs(vector<pair<int, int>> & pairsRtn) const {
+	int count = pairsRtn.size();
+	for (int a = 0; a < entities.size(); a++) {
+		if (entities[a].node == -1) continue;
+		scratch.clear();
+		query(entities[a].bounds, 0, 0, 0, 0, a, scratch);
+		for (int i = 0; i < scratch.size(); i++) pairsRtn.push_back(make_pair(a, scratch[i]));
+	}
+	return pairsRtn.size() - count;
+}
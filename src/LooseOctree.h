@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ofMain.h"
+#include "box.h"
+
+//  Loose octree for moving objects (landers, particles, emitters).
+//
+//  The tree covers a fixed cube and every level is allocated up front as a
+//  dense grid, so a node is found from a position by arithmetic instead of a
+//  walk.  Each node's bounds are loosened to twice its cell size, which lets
+//  an object live in the deepest cell whose size is at least the object's
+//  extent and that contains its center.  Small moves usually stay in the same
+//  cell, so update() is then just a bounds write.  Moving to another cell costs
+//  one unlink/link plus a per-level count update along both paths.
+//
+//  Objects are referred to by the int handle returned from insert().  Handles
+//  are reused after remove().
+//
+class LooseOctree {
+public:
+	void setup(const Box & world, int depth = 6);
+	void clear();
+
+	int insert(const Box & bounds, int userData = 0);
+	void remove(int handle);
+	void update(int handle, const Box & bounds);		// stale or removed handles are ignored, as in remove()
+
+	int overlap(const Box & box, vector<int> & handlesRtn) const;
+	int pairs(vector<pair<int, int>> & pairsRtn) const;
+
+	const Box & bounds(int handle) const { return entities[handle].bounds; }
+	int userData(int handle) const { return entities[handle].userData; }
+	int size() const { return numEntities; }
+
+private:
+	struct Entity {
+		Box bounds;
+		int userData;
+		int node;		// -1 when the handle is free
+		int next;		// next in node list, or next free handle
+		int prev;
+	};
+
+	struct Node {
+		int head = -1;	// first entity stored in this node
+		int count = 0;	// entities in this node and everything below it
+	};
+
+	int nodeFor(const Box & bounds) const;
+	int nodeIndex(int level, int ix, int iy, int iz) const;
+	void link(int handle, int node);
+	void unlink(int handle);
+	void adjustCounts(int node, int delta);
+	void query(const Box & box, int level, int ix, int iy, int iz, int skip, vector<int> & handlesRtn) const;
+
+	Vector3 origin;
+	float worldSize = 1;
+	int depth = 0;
+	vector<int> levelOffset;
+	vector<Node> nodes;
+	vector<int> nodeLevel;		// level of each node, for walking up counts
+	vector<Entity> entities;
+	int freeHandle = -1;
+	int numEntities = 0;
+	mutable vector<int> scratch;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+//  Read-only memory mapping of a whole file.  The mapping lives as long as the
+//  object; pages are faulted in on first touch.
+//
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+
+	bool open(const std::string & path);
+	void close();
+
+	bool isOpen() const { return ptr != NULL; }
+	const char * data() const { return (const char *)ptr; }
+	size_t size() const { return length; }
+
+private:
+	void *ptr = NULL;
+	size_t length = 0;
+#ifdef _WIN32
+	void *file = NULL;
+	void *mapping = NULL;
+#endif
+};
@@ -0,0 +1,133 @@
+#include "MeshFile.h"
+
+static_assert(sizeof(glm::vec3) == 12, "mesh file arrays assume tightly packed vec3");
+static_assert(sizeof(MeshFileHeader) == 56, "mesh file header layout changed");
+
+static const char meshMagic[4] = { 'L', 'M', 'S', 'H' };
+static const uint64_t meshAlign = 64;
+
+static bool isLittleEndian() {
+	uint16_t one = 1;
+	return *(uint8_t *)&one == 1;
+}
+
+static uint64_t alignUp(uint64_t offset) {
+	return (offset + meshAlign - 1) & ~(meshAlign - 1);
+}
+
+static void pad(ofstream & out, uint64_t offset) {
+	static const char zeros[64] = { 0 };
+	uint64_t at = out.tellp();
+	if (offset > at) out.write(zeros, offset - at);
+}
+
+bool MeshFile::write(const string & path, const ofMesh & mesh) {
+	if (!isLittleEndian()) return false;
+
+	MeshFileHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, meshMagic, sizeof(h.magic));
+	h.version = version;
+	h.vertexCount = mesh.getNumVertices();
+	h.indexCount = mesh.getNumIndices();
+	bool hasNormals = mesh.getNumNormals() == h.vertexCount && h.vertexCount > 0;
+	h.flags = hasNormals ? HAS_NORMALS : 0;
+
+	uint64_t offset = alignUp(sizeof(h));
+	h.positionOffset = offset;
+	offset = alignUp(offset + h.vertexCount * sizeof(glm::vec3));
+	if (hasNormals) {
+		h.normalOffset = offset;
+		offset = alignUp(offset + h.vertexCount * sizeof(glm::vec3));
+	}
+	h.indexOffset = offset;
+
+	ofstream out(path, ios::binary);
+	if (!out) return false;
+	out.write((const char *)&h, sizeof(h));
+	pad(out, h.positionOffset);
+	out.write((const char *)mesh.getVerticesPointer(), h.vertexCount * sizeof(glm::vec3));
+	if (hasNormals) {
+		pad(out, h.normalOffset);
+		out.write((const char *)mesh.getNormals().data(), h.vertexCount * sizeof(glm::vec3));
+	}
+	pad(out, h.indexOffset);
+	if (sizeof(ofIndexType) == sizeof(uint32_t)) {
+		out.write((const char *)mesh.getIndexPointer(), h.indexCount * sizeof(uint32_t));
+	}
+	else {
+		for (size_t i = 0; i < h.indexCount; i++) {
+			uint32_t index = mesh.getIndex(i);
+			out.write((const char *)&index, sizeof(index));
+		}
+	}
+	return (bool)out;
+}
+
+// true if bytes at offset lie inside a file of "size" bytes, without
+// overflowing on offsets near 2^64
+//
+static bool fits(uint64_t offset, uint64_t bytes, uint64_t size) {
+	return offset <= size && bytes <= size - offset;
+}
+
+//  Map the file and check the header, then scan the indices once so every
+//  one refers to a vertex.  The other arrays are not read, so positions and
+//  normals cost nothing until they're touched.
+//
+bool MeshFile::open(const string & path) {
+	close();
+	if (!isLittleEndian() || !file.open(path)) return false;
+	if (file.size() < sizeof(MeshFileHeader)) {
+		close();
+		return false;
+	}
+	const MeshFileHeader *h = (const MeshFileHeader *)file.data();
+	uint64_t size = file.size();
+	bool ok = memcmp(h->magic, meshMagic, sizeof(meshMagic)) == 0 && h->version == version &&
+		h->vertexCount < (1ull << 40) && h->indexCount < (1ull << 40);
+	uint64_t arrayBytes = h->vertexCount * sizeof(glm::vec3);
+	ok = ok && h->positionOffset % meshAlign == 0 && fits(h->positionOffset, arrayBytes, size) &&
+		h->indexOffset % meshAlign == 0 && fits(h->indexOffset, h->indexCount * sizeof(uint32_t), size);
+	if (ok && (h->flags & HAS_NORMALS)) {
+		ok = h->normalOffset % meshAlign == 0 && fits(h->normalOffset, arrayBytes, size);
+	}
+	if (ok) {
+		const uint32_t *index = (const uint32_t *)(file.data() + h->indexOffset);
+		for (uint64_t i = 0; i < h->indexCount && ok; i++) ok = index[i] < h->vertexCount;
+	}
+	if (!ok) {
+		close();
+		return false;
+	}
+	header = h;
+	return true;
+}
+
+void MeshFile::close() {
+	header = NULL;
+	file.close();
+}
+
+const glm::vec3 * MeshFile::positions() const {
+	return header ? (const glm::vec3 *)(file.data() + header->positionOffset) : NULL;
+}
+
+const glm::vec3 * MeshFile::normals() const {
+	return header && (header->flags & HAS_NORMALS) ? (const glm::vec3 *)(file.data() + header->normalOffset) : NULL;
+}
+
+const uint32_t * MeshFile::indices() const {
+	return header ? (const uint32_t *)(file.data() + header->indexOffset) : NULL;
+}
+
+// copy into an ofMesh, for consumers (GPU upload, Octree) that need one
+//
+void MeshFile::copyTo(ofMesh & mesh) const {
+	mesh.clear();
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	if (!header) return;
+	mesh.getVertices().assign(positions(), positions() + numVertices());
+	if (normals()) mesh.getNormals().assign(normals(), normals() + numVertices());
+	mesh.getIndices().assign(indices(), indices() + numIndices());
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ofMain.h"
+#include "MappedFile.h"
+
+//  ".lmsh" binary mesh file: a fixed header followed by raw little endian
+//  arrays of positions (3 floats), optional normals (3 floats) and triangle
+//  indices (uint32).  Every array starts on a 64 byte boundary so a memory
+//  mapped file can be used in place; open() only maps and validates (header,
+//  array bounds and index range), and the accessors point straight into the
+//  mapping.
+//
+struct MeshFileHeader {
+	char magic[4];				// "LMSH"
+	uint32_t version;
+	uint32_t flags;				// MeshFile::HAS_NORMALS
+	uint32_t reserved;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t positionOffset;	// byte offsets from the start of the file
+	uint64_t normalOffset;		// 0 without normals
+	uint64_t indexOffset;
+};
+
+class MeshFile {
+public:
+	enum { HAS_NORMALS = 1 };
+	static const uint32_t version = 1;
+
+	static bool write(const string & path, const ofMesh & mesh);
+
+	bool open(const string & path);
+	void close();
+	bool isOpen() const { return header != NULL; }
+
+	size_t numVertices() const { return header ? header->vertexCount : 0; }
+	size_t numIndices() const { return header ? header->indexCount : 0; }
+	const glm::vec3 * positions() const;
+	const glm::vec3 * normals() const;		// NULL if the file has none
+	const uint32_t * indices() const;
+
+	void copyTo(ofMesh & mesh) const;
+
+private:
+	MappedFile file;
+	const MeshFileHeader *header = NULL;
+};
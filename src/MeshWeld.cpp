@@ -0,0 +1,77 @@
+#include "MeshWeld.h"
+#include <unordered_map>
+
+static uint64_t cellKey(int64_t x, int64_t y, int64_t z) {
+	const uint64_t mask = (1 << 21) - 1;
+	return ((uint64_t)x & mask) | (((uint64_t)y & mask) << 21) | (((uint64_t)z & mask) << 42);
+}
+
+int weldVertices(const ofMesh & mesh, float epsilon, vector<int> & remapRtn, vector<int> & uniqueRtn) {
+	int n = mesh.getNumVertices();
+	remapRtn.resize(n);
+	uniqueRtn.clear();
+
+	// chains of unique vertices per grid cell: head[cell] -> next[] -> ... -1
+	//
+	unordered_map<uint64_t, int> head;
+	head.reserve(n);
+	vector<int> next;
+	next.reserve(n);
+
+	if (epsilon <= 0) {
+		for (int i = 0; i < n; i++) {
+			glm::vec3 p = mesh.getVertex(i);
+			uint32_t b[3];
+			memcpy(b, &p, sizeof(b));
+			uint64_t key = (uint64_t)b[0] * 0x9E3779B97F4A7C15ull ^ (uint64_t)b[1] * 0xC2B2AE3D27D4EB4Full ^ b[2];
+			auto it = head.find(key);
+			int found = -1;
+			for (int k = it == head.end() ? -1 : it->second; k != -1 && found == -1; k = next[k]) {
+				if (mesh.getVertex(uniqueRtn[k]) == p) found = k;
+			}
+			if (found == -1) {
+				found = uniqueRtn.size();
+				next.push_back(it == head.end() ? -1 : it->second);
+				head[key] = found;
+				uniqueRtn.push_back(i);
+			}
+			remapRtn[i] = found;
+		}
+		return uniqueRtn.size();
+	}
+
+	float inv = 1 / epsilon;
+	float eps2 = epsilon * epsilon;
+	for (int i = 0; i < n; i++) {
+		glm::vec3 p = mesh.getVertex(i);
+		int64_t cx = (int64_t)floor(p.x * inv);
+		int64_t cy = (int64_t)floor(p.y * inv);
+		int64_t cz = (int64_t)floor(p.z * inv);
+
+		int found = -1;
+		for (int dz = -1; dz <= 1 && found == -1; dz++) {
+			for (int dy = -1; dy <= 1 && found == -1; dy++) {
+				for (int dx = -1; dx <= 1 && found == -1; dx++) {
+					auto it = head.find(cellKey(cx + dx, cy + dy, cz + dz));
+					if (it == head.end()) continue;
+					for (int k = it->second; k != -1; k = next[k]) {
+						if (glm::distance2(mesh.getVertex(uniqueRtn[k]), p) <= eps2) {
+							found = k;
+							break;
+						}
+					}
+				}
+			}
+		}
+		if (found == -1) {
+			found = uniqueRtn.size();
+			uint64_t key = cellKey(cx, cy, cz);
+			auto it = head.find(key);
+			next.push_back(it == head.end() ? -1 : it->second);
+			head[key] = found;
+			uniqueRtn.push_back(i);
+		}
+		remapRtn[i] = found;
+	}
+	return uniqueRtn.size();
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  weldVertices:  merge mesh vertices closer than epsilon.
+//
+//  uniqueRtn gets one representative mesh vertex index per welded position
+//  (the first vertex seen there).  remapRtn maps every mesh vertex to its
+//  slot in uniqueRtn.  Positions are hashed on an epsilon sized grid and
+//  compared against the 27 surrounding cells, so the cost is linear in the
+//  vertex count.  An epsilon of 0 merges only bit-identical positions.
+//  Returns the number of unique positions.
+//
+int weldVertices(const ofMesh & mesh, float epsilon, vector<int> & remapRtn, vector<int> & uniqueRtn);
@@ -0,0 +1,241 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include <thread>
+
+namespace {
+
+struct Chunk {
+	const char *begin, *end;
+	size_t vertices = 0;		// "v" lines in this chunk
+	size_t triangles = 0;		// triangles after fan triangulation
+	size_t firstVertex = 0;		// prefix sums over the earlier chunks
+	size_t firstTriangle = 0;
+	bool ok = true;
+};
+
+inline bool isBlank(char c) {
+	return c == ' ' || c == '\t';
+}
+
+inline const char * skipBlanks(const char *p, const char *end) {
+	while (p < end && isBlank(*p)) p++;
+	return p;
+}
+
+inline const char * nextLine(const char *p, const char *end) {
+	const char *nl = (const char *)memchr(p, '\n', end - p);
+	return nl ? nl + 1 : end;
+}
+
+//  Decimal float parser for the plain "-12.345e-6" forms OBJ exporters write.
+//  Accumulates the digits as an integer and scales once by a power of ten.
+//
+const double powersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline double scale10(double v, int exponent) {
+	while (exponent > 22) { v *= 1e22; exponent -= 22; }
+	while (exponent < -22) { v /= 1e22; exponent += 22; }
+	return exponent >= 0 ? v * powersOf10[exponent] : v / powersOf10[-exponent];
+}
+
+const char * parseFloat(const char *p, const char *end, float & value) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	const char *start = p;
+	while (p < end && *p >= '0' && *p <= '9') {
+		if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; }
+		else exponent++;
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; exponent--; }
+			p++;
+		}
+	}
+	if (p == start) return NULL;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		bool negativeExp = false;
+		if (q < end && (*q == '-' || *q == '+')) negativeExp = *q++ == '-';
+		int e = 0;
+		if (q < end && *q >= '0' && *q <= '9') {
+			while (q < end && *q >= '0' && *q <= '9') e = std::min(e * 10 + (*q++ - '0'), 10000);
+			exponent += negativeExp ? -e : e;
+			p = q;
+		}
+	}
+	double v = scale10((double)mantissa, exponent);
+	value = (float)(negative ? -v : v);
+	return p;
+}
+
+// integer part of a face reference ("12", "12/3", "12//5", "-1/2/3")
+//
+inline const char * parseIndex(const char *p, const char *end, long & value) {
+	bool negative = false;
+	if (p < end && *p == '-') { negative = true; p++; }
+	const char *start = p;
+	long v = 0;
+	while (p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+	if (p == start) return NULL;
+	value = negative ? -v : v;
+	while (p < end && !isBlank(*p) && *p != '\r' && *p != '\n') p++;		// texture / normal refs
+	return p;
+}
+
+inline bool isTag(const char *p, const char *end, char tag) {
+	return p + 1 < end && p[0] == tag && isBlank(p[1]);
+}
+
+// pass 1: count vertices and triangles
+//
+void countChunk(Chunk & chunk) {
+	for (const char *p = chunk.begin; p < chunk.end; p = nextLine(p, chunk.end)) {
+		const char *q = skipBlanks(p, chunk.end);
+		if (isTag(q, chunk.end, 'v')) chunk.vertices++;
+		else if (isTag(q, chunk.end, 'f')) {
+			const char *lineEnd = nextLine(q, chunk.end);
+			int refs = 0;
+			q += 1;
+			while (true) {
+				q = skipBlanks(q, lineEnd);
+				if (q >= lineEnd || *q == '\r' || *q == '\n' || *q == '#') break;
+				refs++;
+				while (q < lineEnd && !isBlank(*q) && *q != '\r' && *q != '\n') q++;
+			}
+			if (refs >= 3) chunk.triangles += refs - 2;
+		}
+	}
+}
+
+// pass 2: parse straight into the chunk's slice of the output arrays
+//
+void parseChunk(Chunk & chunk, glm::vec3 *positions, ofIndexType *indices, size_t totalVertices) {
+	size_t v = chunk.firstVertex;
+	ofIndexType *out = indices + chunk.firstTriangle * 3;
+	for (const char *p = chunk.begin; p < chunk.end && chunk.ok; p = nextLine(p, chunk.end)) {
+		const char *q = skipBlanks(p, chunk.end);
+		if (isTag(q, chunk.end, 'v')) {
+			glm::vec3 & pos = positions[v++];
+			for (int a = 0; a < 3 && chunk.ok; a++) {
+				q = parseFloat(skipBlanks(q + (a == 0 ? 1 : 0), chunk.end), chunk.end, pos[a]);
+				chunk.ok = q != NULL;
+			}
+		}
+		else if (isTag(q, chunk.end, 'f')) {
+			const char *lineEnd = nextLine(q, chunk.end);
+			q += 1;
+			long first = 0, prev = 0;
+			int refs = 0;
+			while (chunk.ok) {
+				q = skipBlanks(q, lineEnd);
+				if (q >= lineEnd || *q == '\r' || *q == '\n' || *q == '#') break;
+				long index;
+				q = parseIndex(q, lineEnd, index);
+				if (q == NULL) { chunk.ok = false; break; }
+
+				// OBJ is 1 based; negative indices count back from the
+				// last vertex read so far
+				//
+				index = index < 0 ? (long)v + index : index - 1;
+				if (index < 0 || index >= (long)totalVertices) { chunk.ok = false; break; }
+
+				if (refs == 0) first = index;
+				else if (refs >= 2) {
+					*out++ = first;
+					*out++ = prev;
+					*out++ = index;
+				}
+				prev = index;
+				refs++;
+			}
+		}
+	}
+}
+
+template <class F> void runParallel(vector<Chunk> & chunks, F f) {
+	vector<std::thread> threads;
+	for (int i = 1; i < chunks.size(); i++) threads.push_back(std::thread(f, std::ref(chunks[i])));
+	f(chunks[0]);
+	for (auto & t : threads) t.join();
+}
+
+}
+
+bool ObjLoader::load(const string & path, ofMesh & meshRtn, int numThreads) {
+	MappedFile file;
+	if (!file.open(path)) return false;
+	const char *data = file.data();
+	const char *end = data + file.size();
+
+	// line aligned chunks, one per thread; small files are not worth splitting
+	//
+	if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::max(1, std::min(numThreads, (int)(file.size() >> 20) + 1));
+	vector<Chunk> chunks(numThreads);
+	const char *p = data;
+	for (int i = 0; i < numThreads; i++) {
+		chunks[i].begin = p;
+		p = i == numThreads - 1 ? end : std::max(p, data + file.size() * (i + 1) / numThreads);
+		if (p < end && p > data && p[-1] != '\n') p = nextLine(p, end);
+		chunks[i].end = p;
+	}
+
+	runParallel(chunks, countChunk);
+
+	size_t vertices = 0, triangles = 0;
+	for (auto & chunk : chunks) {
+		chunk.firstVertex = vertices;
+		chunk.firstTriangle = triangles;
+		vertices += chunk.vertices;
+		triangles += chunk.triangles;
+	}
+	if (vertices == 0) return false;
+
+	meshRtn.clear();
+	meshRtn.setMode(OF_PRIMITIVE_TRIANGLES);
+	meshRtn.getVertices().resize(vertices);
+	meshRtn.getIndices().resize(triangles * 3);
+	glm::vec3 *positions = meshRtn.getVertices().data();
+	ofIndexType *indices = meshRtn.getIndices().data();
+
+	runParallel(chunks, [&](Chunk & chunk) { parseChunk(chunk, positions, indices, vertices); });
+
+	for (auto & chunk : chunks) {
+		if (!chunk.ok) {
+			cout << "Error: malformed OBJ " << path << endl;
+			meshRtn.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+void ObjLoader::computeNormals(ofMesh & mesh) {
+	vector<glm::vec3> & normals = mesh.getNormals();
+	normals.assign(mesh.getNumVertices(), glm::vec3(0, 0, 0));
+	const vector<glm::vec3> & v = mesh.getVertices();
+	const vector<ofIndexType> & idx = mesh.getIndices();
+	for (size_t i = 0; i + 2 < idx.size(); i += 3) {
+
+		// unnormalized cross product: length is twice the triangle area
+		//
+		glm::vec3 n = glm::cross(v[idx[i + 1]] - v[idx[i]], v[idx[i + 2]] - v[idx[i]]);
+		normals[idx[i]] += n;
+		normals[idx[i + 1]] += n;
+		normals[idx[i + 2]] += n;
+	}
+	for (auto & n : normals) {
+		float len = glm::length(n);
+		n = len > 0 ? n / len : glm::vec3(0, 1, 0);
+	}
+}
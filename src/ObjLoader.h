@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  Fast loader for Wavefront OBJ terrain.  Reads only what the game uses:
+//  vertex positions ("v") and faces ("f", fan triangulated).  Texture
+//  coordinates, normals, groups and materials are skipped.
+//
+//  The file is memory mapped and cut into line aligned chunks that are parsed
+//  in parallel in two passes: the first counts vertices and triangles per
+//  chunk, the second parses each chunk straight into its slice of the mesh's
+//  position and index arrays.  Nothing is copied after parsing.
+//
+class ObjLoader {
+public:
+	static bool load(const string & path, ofMesh & meshRtn, int numThreads = 0);
+
+	// smooth per-vertex normals, weighted by triangle area
+	//
+	static void computeNormals(ofMesh & mesh);
+};
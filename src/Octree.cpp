@@ -21,7 +21,7 @@ void Octree::drawBox(const Box &box) {
 	Vector3 max = box.parameters[1];
 	Vector3 size = max - min;
 	Vector3 center = size / 2 + min;
-	ofVec3f p = ofVec3f(center.x(), center.y(), center.z());
+	glm::vec3 p = center;
 	float w = size.x();
 	float h = size.y();
 	float d = size.z();
@@ -32,24 +32,15 @@ void Octree::drawBox(const Box &box) {
 //
 Box Octree::meshBounds(const ofMesh & mesh) {
 	int n = mesh.getNumVertices();
-	ofVec3f v = mesh.getVertex(0);
-	ofVec3f max = v;
-	ofVec3f min = v;
+	const glm::vec3 *v = mesh.getVerticesPointer();
+	Vector3 max = v[0];
+	Vector3 min = v[0];
 	for (int i = 1; i < n; i++) {
-		ofVec3f v = mesh.getVertex(i);
-
-		if (v.x > max.x) max.x = v.x;
-		else if (v.x < min.x) min.x = v.x;
-
-		if (v.y > max.y) max.y = v.y;
-		else if (v.y < min.y) min.y = v.y;
-
-		if (v.z > max.z) max.z = v.z;
-		else if (v.z < min.z) min.z = v.z;
+		Vector3 p = v[i];
+		min = Vector3::min(min, p);
+		max = Vector3::max(max, p);
 	}
-	cout << "vertices: " << n << endl;
-//	cout << "min: " << min << "max: " << max << endl;
-	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+	return Box(min, max);
 }
 
 // getMeshPointsInBox:  return an array of indices to points in mesh that are contained 
@@ -59,9 +50,9 @@ int Octree::getMeshPointsInBox(const ofMesh & mesh, const vector<int>& points,
 	Box & box, vector<int> & pointsRtn)
 {
 	int count = 0;
+	const glm::vec3 *v = mesh.getVerticesPointer();
 	for (int i = 0; i < points.size(); i++) {
-		ofVec3f v = mesh.getVertex(points[i]);
-		if (box.inside(Vector3(v.x, v.y, v.z))) {
+		if (box.inside(v[points[i]])) {
 			count++;
 			pointsRtn.push_back(points[i]);
 		}
@@ -78,14 +69,10 @@ int Octree::getMeshFacesInBox(const ofMesh & mesh, const vector<int>& faces,
 	int count = 0;
 	for (int i = 0; i < faces.size(); i++) {
 		ofMeshFace face = mesh.getFace(faces[i]);
-		ofVec3f v[3];
-		v[0] = face.getVertex(0);
-		v[1] = face.getVertex(1);
-		v[2] = face.getVertex(2);
 		Vector3 p[3];
-		p[0] = Vector3(v[0].x, v[0].y, v[0].z);
-		p[1] = Vector3(v[1].x, v[1].y, v[1].z);
-		p[2] = Vector3(v[2].x, v[2].y, v[2].z);
+		p[0] = face.getVertex(0);
+		p[1] = face.getVertex(1);
+		p[2] = face.getVertex(2);
 		if (box.inside(p,3)) {
 			count++;
 			facesRtn.push_back(faces[i]);
@@ -129,13 +116,18 @@ void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
 void Octree::create(const ofMesh & geo, int numLevels) {
 	// initialize octree structure
 	//
+	uint64_t start = ofGetElapsedTimeMicros();
 	mesh = geo;
 	int level = 0;
+	root = TreeNode();
 	root.box = meshBounds(mesh);
 	if (!bUseFaces) {
-		for (int i = 0; i < mesh.getNumVertices(); i++) {
-			root.points.push_back(i);
-		}
+
+		// coincident vertices (one per adjacent face in most OBJ exports)
+		// can never be split apart, so only one of each goes in the tree
+		//
+		weldVertices(mesh, weldEpsilon, weldRemap, weldUnique);
+		root.points = weldUnique;
 	}
 	else {
 		// need to load face vertices here
@@ -146,6 +138,142 @@ void Octree::create(const ofMesh & geo, int numLevels) {
 	//
 	level++;
     subdivide(mesh, root, numLevels, level);
+
+	// children never move after this point, so parent links stay valid
+	//
+	root.parent = NULL;
+	linkParents(root);
+	leafX.clear();
+	leafY.clear();
+	leafZ.clear();
+	packLeaves(root);
+	bDebugMeshesDirty = true;
+	buildMicros = ofGetElapsedTimeMicros() - start;
+}
+
+int Octree::countNodes(const TreeNode & node) {
+	int count = 1;
+	for (int i = 0; i < node.children.size(); i++) count += countNodes(node.children[i]);
+	return count;
+}
+
+void Octree::linkParents(TreeNode & node) {
+	for (int i = 0; i < node.children.size(); i++) {
+		node.children[i].parent = &node;
+		linkParents(node.children[i]);
+	}
+}
+
+void Octree::packLeaves(TreeNode & node) {
+	if (node.children.empty()) {
+		node.first = leafX.size();
+		for (int i = 0; i < node.points.size(); i++) {
+			const glm::vec3 & p = mesh.getVertex(node.points[i]);
+			leafX.push_back(p.x);
+			leafY.push_back(p.y);
+			leafZ.push_back(p.z);
+		}
+	}
+	for (int i = 0; i < node.children.size(); i++) packLeaves(node.children[i]);
+}
+
+//  Binary octree file:  "LOCT", version, mesh vertices, normals and indices,
+//  the weld tables, then the nodes in depth first order (box, points, child
+//  count).  Written in host byte order; files are meant for the machine that
+//  built them.
+//
+static const char octreeMagic[4] = { 'L', 'O', 'C', 'T' };
+static const int octreeVersion = 3;
+
+template <class T> static void writeArray(ofstream & out, const vector<T> & v) {
+	int n = v.size();
+	out.write((const char *)&n, sizeof(n));
+	if (n > 0) out.write((const char *)v.data(), n * sizeof(T));
+}
+
+template <class T> static bool readArray(ifstream & in, vector<T> & v) {
+	int n = 0;
+	in.read((char *)&n, sizeof(n));
+	if (!in || n < 0) return false;
+	v.resize(n);
+	if (n > 0) in.read((char *)v.data(), n * sizeof(T));
+	return (bool)in;
+}
+
+static void writeNode(ofstream & out, const TreeNode & node) {
+	out.write((const char *)node.box.parameters, sizeof(node.box.parameters));
+	writeArray(out, node.points);
+	int n = node.children.size();
+	out.write((const char *)&n, sizeof(n));
+	for (int i = 0; i < n; i++) writeNode(out, node.children[i]);
+}
+
+static bool readNode(ifstream & in, TreeNode & node) {
+	in.read((char *)node.box.parameters, sizeof(node.box.parameters));
+	if (!readArray(in, node.points)) return false;
+	int n = 0;
+	in.read((char *)&n, sizeof(n));
+	if (!in || n < 0 || n > 8) return false;
+	node.children.resize(n);
+	node.intersects = n > 0;
+	for (int i = 0; i < n; i++) {
+		if (!readNode(in, node.children[i])) return false;
+	}
+	return true;
+}
+
+bool Octree::save(const string & path) const {
+	ofstream out(path, ios::binary);
+	if (!out) return false;
+	out.write(octreeMagic, sizeof(octreeMagic));
+	out.write((const char *)&octreeVersion, sizeof(octreeVersion));
+	writeArray(out, mesh.getVertices());
+	writeArray(out, mesh.getNormals());
+	writeArray(out, mesh.getIndices());
+	writeArray(out, weldRemap);
+	writeArray(out, weldUnique);
+	writeNode(out, root);
+	return (bool)out;
+}
+
+bool Octree::load(const string & path) {
+	ifstream in(path, ios::binary);
+	char magic[4];
+	int version = 0;
+	in.read(magic, sizeof(magic));
+	in.read((char *)&version, sizeof(version));
+	if (!in || memcmp(magic, octreeMagic, sizeof(magic)) != 0 || version != octreeVersion) return false;
+
+	mesh.clear();
+	root = TreeNode();
+	bDebugMeshesDirty = true;
+	if (!readArray(in, mesh.getVertices()) || !readArray(in, mesh.getNormals()) ||
+		!readArray(in, mesh.getIndices()) || !readArray(in, weldRemap) || !readArray(in, weldUnique) ||
+		!readNode(in, root)) {
+		return false;
+	}
+	root.parent = NULL;
+	linkParents(root);
+	leafX.clear();
+	leafY.clear();
+	leafZ.clear();
+	packLeaves(root);
+	return true;
+}
+
+static size_t nodeMemory(const TreeNode & node) {
+	size_t bytes = sizeof(TreeNode) + node.points.capacity() * (sizeof(int) + 3 * sizeof(float));
+	for (int i = 0; i < node.children.size(); i++) bytes += nodeMemory(node.children[i]);
+	return bytes;
+}
+
+// approximate heap footprint of the tree plus its copy of the mesh
+//
+size_t Octree::memoryUsage() const {
+	return nodeMemory(root) +
+		mesh.getNumVertices() * sizeof(glm::vec3) +
+		mesh.getNumNormals() * sizeof(glm::vec3) +
+		mesh.getNumIndices() * sizeof(ofIndexType);
 }
 
 
@@ -153,129 +281,517 @@ void Octree::create(const ofMesh & geo, int numLevels) {
 // subdivide:  recursive function to perform octree subdivision on a mesh
 //
 //  subdivide(node) algorithm:
-//     1) subdivide box in node into 8 equal side boxes - see helper function subDivideBox8().
-//     2) For each child box
-//            sort point data into each box  (see helper function getMeshFacesInBox())
-//        if a child box contains at list 1 point
-//            add child to tree
-//            if child is not a leaf node (contains more than 1 point)
-//               recursively call subdivide(child)
-//         
-//      
-             
+//     1) stop if the node is small enough to be a leaf: at most leafSize
+//        points, at the level limit, or narrower than minExtent
+//     2) sort the node's points into the 8 octants of its box (see
+//        classifyPoints(), boxes in subDivideBox8() order)
+//     3) for small nodes (up to 4 * leafSize points) compare the estimated
+//        cost of testing every point against the cost of visiting the
+//        occupied children plus a quarter of the points (a ray or box
+//        typically touches a quarter of the octants), and stay a leaf
+//        if splitting doesn't pay
+//     4) add a child for every occupied octant and recurse into it
+//
 void Octree::subdivide(const ofMesh & mesh, TreeNode & node, int numLevels, int level) {
 	if (level >= numLevels) return;
+	int n = node.points.size();
+	if (n <= leafSize) return;
+	Vector3 size = node.box.max() - node.box.min();
+	if (std::max(size.x(), std::max(size.y(), size.z())) < minExtent) return;
+
+	classifyPoints(mesh, node.points, node.box.center(), octants);
+	int counts[8] = { 0 };
+	for (int i = 0; i < n; i++) counts[octants[i]]++;
+	int occupied = 0;
+	for (int c = 0; c < 8; c++) if (counts[c] > 0) occupied++;
+
+	if (leafSize > 1 && n <= 4 * leafSize) {
+		float splitCost = traversalCost * occupied + pointCost * n / 4;
+		if (splitCost >= pointCost * n) return;
+	}
 
-	// subdvide algorithm implemented here
-	
 	vector<Box> boxlist;
-	TreeNode temp;
 	subDivideBox8(node.box, boxlist);
-	
-	for (int i = 0; i < boxlist.size(); i++) {
-		temp.box = boxlist[i];
-		getMeshPointsInBox(mesh, node.points, temp.box, temp.points);
-		if (temp.points.size() > 0)
-			node.children.push_back(temp);
+	int slot[8];
+	node.children.reserve(occupied);
+	for (int c = 0; c < 8; c++) {
+		slot[c] = -1;
+		if (counts[c] == 0) continue;
+		slot[c] = node.children.size();
+		node.children.push_back(TreeNode());
+		node.children.back().box = boxlist[c];
+		node.children.back().points.reserve(counts[c]);
 	}
-
-	node.points.clear();
+	for (int i = 0; i < n; i++) {
+		node.children[slot[octants[i]]].points.push_back(node.points[i]);
+	}
+	vector<int>().swap(node.points);
 	level++;
 
 	for (int i = 0; i < node.children.size(); i++) {
-		if (node.children[i].points.size() != 1) {
+		if (node.children[i].points.size() > leafSize) {
 			node.children[i].intersects = true;
 			subdivide(mesh, node.children[i], numLevels, level);
 		}
 	}
-	
 }
 
-// Implement functions below for Homework project
+const uint8_t Octree::octantOrder[8] = { 0, 1, 3, 2, 4, 5, 7, 6 };
+
+//  classifyPoints:  octant of each point relative to center.  Points on a
+//                   split plane go to the upper side, so every point lands in
+//                   exactly one child.  Coordinates are gathered into flat
+//                   arrays and compared four at a time.
 //
+void Octree::classifyPoints(const ofMesh & mesh, const vector<int> & points, const Vector3 & center, vector<uint8_t> & octantsRtn) {
+	int n = points.size();
+	gatherX.resize(n);
+	gatherY.resize(n);
+	gatherZ.resize(n);
+	octantsRtn.resize(n);
+	const glm::vec3 *v = mesh.getVerticesPointer();
+	for (int i = 0; i < n; i++) {
+		const glm::vec3 & p = v[points[i]];
+		gatherX[i] = p.x;
+		gatherY[i] = p.y;
+		gatherZ[i] = p.z;
+	}
 
-bool Octree::intersect(const Ray &ray, const TreeNode & node, TreeNode & nodeRtn) {
-	bool intersects = false;
-	if (node.box.intersect(ray, -1000, 1000)) {
-		if (node.points.size() == 1) {
-			nodeRtn = node;
-			return true;
+	int i = 0;
+#ifdef OCTREE_SSE2
+	__m128 cx = _mm_set1_ps(center.x());
+	__m128 cy = _mm_set1_ps(center.y());
+	__m128 cz = _mm_set1_ps(center.z());
+	for (; i + 4 <= n; i += 4) {
+		int mx = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&gatherX[i]), cx));
+		int my = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&gatherY[i]), cy));
+		int mz = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&gatherZ[i]), cz));
+		for (int k = 0; k < 4; k++) {
+			octantsRtn[i + k] = octantOrder[((mx >> k) & 1) | (((mz >> k) & 1) << 1) | (((my >> k) & 1) << 2)];
 		}
-		for (int i = 0; i < node.children.size(); i++) {
-			if (intersect(ray, node.children[i], nodeRtn)) {
-				return true;
+	}
+#endif
+	for (; i < n; i++) {
+		int bits = (gatherX[i] >= center.x()) | ((gatherZ[i] >= center.z()) << 1) | ((gatherY[i] >= center.y()) << 2);
+		octantsRtn[i] = octantOrder[bits];
+	}
+}
+
+//  closestPoint:  the point of a leaf nearest to the ray's line.  Leaves can
+//                 hold up to leafSize points, so a ray hit on a leaf is
+//                 resolved to the point it passes closest to.  Distances are
+//                 computed four points at a time from the packed coordinates;
+//                 ties go to the earlier point, as in the scalar loop.
+//
+int Octree::closestPoint(const TreeNode & leaf, const Ray & ray) const {
+	int n = leaf.points.size();
+	if (n == 1) return leaf.points[0];
+	glm::vec3 o = ray.origin;
+	glm::vec3 d = glm::normalize((glm::vec3)ray.direction);
+	int best = -1;
+	float bestDist = FLT_MAX;
+	int i = 0;
+	if (leaf.first >= 0) {
+		const float *x = leafX.data() + leaf.first;
+		const float *y = leafY.data() + leaf.first;
+		const float *z = leafZ.data() + leaf.first;
+#ifdef OCTREE_SSE2
+		__m128 ox = _mm_set1_ps(o.x), oy = _mm_set1_ps(o.y), oz = _mm_set1_ps(o.z);
+		__m128 dx = _mm_set1_ps(d.x), dy = _mm_set1_ps(d.y), dz = _mm_set1_ps(d.z);
+		float dist[4];
+		for (; i + 4 <= n; i += 4) {
+			__m128 wx = _mm_sub_ps(_mm_loadu_ps(x + i), ox);
+			__m128 wy = _mm_sub_ps(_mm_loadu_ps(y + i), oy);
+			__m128 wz = _mm_sub_ps(_mm_loadu_ps(z + i), oz);
+			__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(wx, dx), _mm_mul_ps(wy, dy)), _mm_mul_ps(wz, dz));
+			__m128 ww = _mm_add_ps(_mm_add_ps(_mm_mul_ps(wx, wx), _mm_mul_ps(wy, wy)), _mm_mul_ps(wz, wz));
+			_mm_storeu_ps(dist, _mm_sub_ps(ww, _mm_mul_ps(t, t)));
+			for (int k = 0; k < 4; k++) {
+				if (dist[k] < bestDist) {
+					bestDist = dist[k];
+					best = leaf.points[i + k];
+				}
+			}
+		}
+#endif
+		for (; i < n; i++) {
+			glm::vec3 w = glm::vec3(x[i], y[i], z[i]) - o;
+			float t = glm::dot(w, d);
+			float dist = glm::dot(w, w) - t * t;
+			if (dist < bestDist) {
+				bestDist = dist;
+				best = leaf.points[i];
 			}
 		}
+		return best;
+	}
+	for (; i < n; i++) {
+		glm::vec3 w = mesh.getVertex(leaf.points[i]) - o;
+		float t = glm::dot(w, d);
+		float dist = glm::dot(w, w) - t * t;
+		if (dist < bestDist) {
+			bestDist = dist;
+			best = leaf.points[i];
+		}
+	}
+	return best;
+}
+
+//  leafPointsInBox:  points of a leaf inside box, tested four at a time.
+//                    Appends them to pointsRtn, or with no pointsRtn stops
+//                    at the first one.  Returns the number found.
+//
+int Octree::leafPointsInBox(const TreeNode & leaf, const Box & box, vector<int> * pointsRtn) const {
+	int n = leaf.points.size();
+	int found = 0;
+	int i = 0;
+	if (leaf.first < 0) {
+		for (; i < n; i++) {
+			if (!box.inside(mesh.getVertex(leaf.points[i]))) continue;
+			found++;
+			if (pointsRtn == NULL) return found;
+			pointsRtn->push_back(leaf.points[i]);
+		}
+		return found;
+	}
+	const float *x = leafX.data() + leaf.first;
+	const float *y = leafY.data() + leaf.first;
+	const float *z = leafZ.data() + leaf.first;
+	Vector3 lo = box.min(), hi = box.max();
+#ifdef OCTREE_SSE2
+	__m128 x0 = _mm_set1_ps(lo.x()), y0 = _mm_set1_ps(lo.y()), z0 = _mm_set1_ps(lo.z());
+	__m128 x1 = _mm_set1_ps(hi.x()), y1 = _mm_set1_ps(hi.y()), z1 = _mm_set1_ps(hi.z());
+	for (; i + 4 <= n; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 in = _mm_and_ps(_mm_cmpge_ps(px, x0), _mm_cmple_ps(px, x1));
+		in = _mm_and_ps(in, _mm_and_ps(_mm_cmpge_ps(py, y0), _mm_cmple_ps(py, y1)));
+		in = _mm_and_ps(in, _mm_and_ps(_mm_cmpge_ps(pz, z0), _mm_cmple_ps(pz, z1)));
+		int mask = _mm_movemask_ps(in);
+		if (mask == 0) continue;
+		for (int k = 0; k < 4; k++) {
+			if (((mask >> k) & 1) == 0) continue;
+			found++;
+			if (pointsRtn == NULL) return found;
+			pointsRtn->push_back(leaf.points[i + k]);
+		}
+	}
+#endif
+	for (; i < n; i++) {
+		if (x[i] < lo.x() || x[i] > hi.x() || y[i] < lo.y() || y[i] > hi.y() || z[i] < lo.z() || z[i] > hi.z()) continue;
+		found++;
+		if (pointsRtn == NULL) return found;
+		pointsRtn->push_back(leaf.points[i]);
 	}
-	return intersects;
+	return found;
 }
 
-bool Octree::intersect(Box &box, TreeNode & node, vector<Box> & boxListRtn) {
-	bool intersects = false;
+// Implement functions below for Homework project
+//
 
-	if (node.box.overlap(box)) {
-		if (node.points.size() == 1) {
-			boxListRtn.push_back(node.box);
+bool Octree::intersect(const Ray &ray, const TreeNode & node, TreeNode & nodeRtn) const {
+	int visited = 0;
+	const TreeNode *leaf = findLeaf(ray, node, visited);
+	if (leaf == NULL) return false;
+	nodeRtn = *leaf;
+	return true;
+}
+
+bool Octree::intersect(const Box &box, const TreeNode & node, vector<Box> & boxListRtn) const {
+	int visited = 0;
+	int count = boxListRtn.size();
+	collectLeaves(box, node, boxListRtn, visited);
+	return boxListRtn.size() > count;
+}
+
+//  Ray query counting visited nodes in the cursor.  Returns the leaf in
+//  place, without copying its points, or NULL on a miss.  The result is the first
+//  crossed leaf in octant order, so it depends on every subtree before the
+//  one last hit; restarting from the cached leaf could return a different
+//  leaf than a root query, which would make picking and altitude depend on
+//  earlier frames.  It always starts at the root.
+//
+const TreeNode * Octree::intersect(const Ray &ray, OctreeCursor & cursor) const {
+	cursor.nodesVisited = 0;
+	return findLeaf(ray, root, cursor.nodesVisited);
+}
+
+//  Box query starting at the deepest node that strictly encloses the box.
+//  Leaves outside that node cannot overlap the box, so the result is the same
+//  as a query from the root.  The cursor climbs out of the cached node when
+//  the box leaves it and sinks back down while a child still encloses it.
+//
+bool Octree::intersect(const Box &box, OctreeCursor & cursor, vector<Box> & boxListRtn) const {
+	cursor.nodesVisited = 0;
+	const TreeNode *node = cursor.node != NULL ? cursor.node : &root;
+	while (node->parent != NULL && !node->box.contains(box)) {
+		node = node->parent;
+		cursor.nodesVisited++;
+	}
+	bool descend = true;
+	while (descend) {
+		descend = false;
+		for (int i = 0; i < node->children.size(); i++) {
+			cursor.nodesVisited++;
+			if (node->children[i].box.contains(box)) {
+				node = &node->children[i];
+				descend = true;
+				break;
+			}
 		}
-		for (int i = 0; i < node.children.size(); i++) {
-			if (intersect(box, node.children[i], boxListRtn)) {
-				return true;
+	}
+	cursor.node = node;
+
+	int count = boxListRtn.size();
+	collectLeaves(box, *node, boxListRtn, cursor.nodesVisited);
+	return boxListRtn.size() > count;
+}
+
+// findLeaf:  depth first search for a leaf (node without children) whose box is
+//            crossed by the ray.
+//
+const TreeNode * Octree::findLeaf(const Ray &ray, const TreeNode & node, int & visited) const {
+	visited++;
+	if (!node.box.intersect(ray, -1000, 1000)) return NULL;
+	if (node.children.empty()) return node.points.empty() ? NULL : &node;
+	for (int i = 0; i < node.children.size(); i++) {
+		const TreeNode *leaf = findLeaf(ray, node.children[i], visited);
+		if (leaf != NULL) return leaf;
+	}
+	return NULL;
+}
+
+// collectLeaves:  append the box of every leaf overlapping "box".  A leaf of
+//                 one point counts on the overlap alone; bigger leaves only
+//                 when one of their points is inside "box", so a large leaf
+//                 brushing the box isn't reported for points far from it.
+//
+void Octree::collectLeaves(const Box &box, const TreeNode & node, vector<Box> & boxListRtn, int & visited) const {
+	visited++;
+	if (!node.box.overlap(box)) return;
+	if (node.children.empty() && !node.points.empty()) {
+		if (node.points.size() == 1 || leafPointsInBox(node, box, NULL) > 0) boxListRtn.push_back(node.box);
+	}
+	for (int i = 0; i < node.children.size(); i++) {
+		collectLeaves(box, node.children[i], boxListRtn, visited);
+	}
+}
+
+// squared distance from p to the closest point of box (0 if inside)
+//
+float Octree::distance2(const Box & box, const glm::vec3 & p) {
+	float dx = std::max(std::max(box.parameters[0].x() - p.x, 0.0f), p.x - box.parameters[1].x());
+	float dy = std::max(std::max(box.parameters[0].y() - p.y, 0.0f), p.y - box.parameters[1].y());
+	float dz = std::max(std::max(box.parameters[0].z() - p.z, 0.0f), p.z - box.parameters[1].z());
+	return dx * dx + dy * dy + dz * dz;
+}
+
+static bool closerHit(const PointHit & a, const PointHit & b) {
+	return a.second < b.second;
+}
+
+static bool fartherNode(const pair<float, const TreeNode *> & a, const pair<float, const TreeNode *> & b) {
+	return a.first > b.first;
+}
+
+//  nearest:  best first search for the k mesh points closest to p.  Nodes are
+//            expanded in order of their box distance and the search stops once
+//            the nearest unexpanded box is farther than the current k-th hit.
+//            Hits come back sorted by distance.  Returns number of hits.
+//
+int Octree::nearest(const glm::vec3 & p, int k, OctreeQueryScratch & scratch, vector<PointHit> & hitsRtn) const {
+	hitsRtn.clear();
+	if (k <= 0) return 0;
+	vector<pair<float, const TreeNode *>> & heap = scratch.nodeHeap;
+	heap.clear();
+	heap.push_back(make_pair(distance2(root.box, p), &root));
+
+	// hitsRtn is kept as a max heap on distance so the worst hit is in front
+	//
+	while (!heap.empty()) {
+		pop_heap(heap.begin(), heap.end(), fartherNode);
+		float nodeDist = heap.back().first;
+		const TreeNode *node = heap.back().second;
+		heap.pop_back();
+		if (hitsRtn.size() == k && nodeDist >= hitsRtn.front().second) break;
+
+		if (node->children.empty()) {
+			for (int i = 0; i < node->points.size(); i++) {
+				int index = node->points[i];
+				float d = glm::distance2(mesh.getVertex(index), p);
+				if (hitsRtn.size() == k && d >= hitsRtn.front().second) continue;
+				if (hitsRtn.size() == k) {
+					pop_heap(hitsRtn.begin(), hitsRtn.end(), closerHit);
+					hitsRtn.pop_back();
 				}
+				hitsRtn.push_back(make_pair(index, d));
+				push_heap(hitsRtn.begin(), hitsRtn.end(), closerHit);
+			}
+		}
+		else {
+			for (int i = 0; i < node->children.size(); i++) {
+				float d = distance2(node->children[i].box, p);
+				if (hitsRtn.size() == k && d >= hitsRtn.front().second) continue;
+				heap.push_back(make_pair(d, &node->children[i]));
+				push_heap(heap.begin(), heap.end(), fartherNode);
+			}
 		}
 	}
+	sort_heap(hitsRtn.begin(), hitsRtn.end(), closerHit);
+	return hitsRtn.size();
+}
 
-	return intersects;
+//  withinRadius:  all mesh points within radius of p, sorted by distance.
+//                 Subtrees whose box is farther than radius are skipped.
+//
+int Octree::withinRadius(const glm::vec3 & p, float radius, OctreeQueryScratch & scratch, vector<PointHit> & hitsRtn) const {
+	hitsRtn.clear();
+	float r2 = radius * radius;
+	vector<const TreeNode *> & stack = scratch.nodeStack;
+	stack.clear();
+	stack.push_back(&root);
+	while (!stack.empty()) {
+		const TreeNode *node = stack.back();
+		stack.pop_back();
+		if (distance2(node->box, p) > r2) continue;
+		for (int i = 0; i < node->points.size(); i++) {
+			float d = glm::distance2(mesh.getVertex(node->points[i]), p);
+			if (d <= r2) hitsRtn.push_back(make_pair(node->points[i], d));
+		}
+		for (int i = 0; i < node->children.size(); i++) {
+			stack.push_back(&node->children[i]);
+		}
+	}
+
+	sort(hitsRtn.begin(), hitsRtn.end(), closerHit);
+	return hitsRtn.size();
+}
+
+//  pointsInBox:  mesh points (weldUnique indices) inside box, ascending
+//
+int Octree::pointsInBox(const Box & box, OctreeQueryScratch & scratch, vector<int> & pointsRtn) const {
+	pointsRtn.clear();
+	vector<const TreeNode *> & stack = scratch.nodeStack;
+	stack.clear();
+	stack.push_back(&root);
+	while (!stack.empty()) {
+		const TreeNode *node = stack.back();
+		stack.pop_back();
+		if (!node->box.overlap(box)) continue;
+		if (node->children.empty()) leafPointsInBox(*node, box, &pointsRtn);
+		for (int i = 0; i < node->children.size(); i++) {
+			stack.push_back(&node->children[i]);
+		}
+	}
+
+	// every point is in exactly one leaf, so only the order needs fixing
+	//
+	sort(pointsRtn.begin(), pointsRtn.end());
+	return pointsRtn.size();
 }
 
-void Octree::draw(TreeNode & node, int numLevels, int level) {
+//  occluded:  any-hit test for the segment origin + t * dir, 0 < t < tMax
+//              (dir unit length).  The mesh is treated as a point cloud with
+//              each point a sphere of the given radius, so the query stops at
+//              the first leaf point that close to the segment.  Subtrees are
+//              skipped when their box grown by radius misses the segment.
+//
+bool Octree::occluded(const glm::vec3 & origin, const glm::vec3 & dir, float tMax, float radius, OctreeQueryScratch & scratch) const {
+	Ray ray(origin, dir);
+	Vector3 grow(radius, radius, radius);
+	float r2 = radius * radius;
+	vector<const TreeNode *> & stack = scratch.nodeStack;
+	stack.clear();
+	stack.push_back(&root);
+	while (!stack.empty()) {
+		const TreeNode *node = stack.back();
+		stack.pop_back();
+		if (!Box(node->box.min() - grow, node->box.max() + grow).intersect(ray, 0, tMax)) continue;
+		if (node->children.empty()) {
+			for (int i = 0; i < node->points.size(); i++) {
+				glm::vec3 w = mesh.getVertex(node->points[i]) - origin;
+				float t = glm::dot(w, dir);
+				if (t > 0 && t < tMax && glm::dot(w, w) - t * t < r2) return true;
+			}
+		}
+		for (int i = 0; i < node->children.size(); i++) {
+			stack.push_back(&node->children[i]);
+		}
+	}
+	return false;
+}
+
+static ofColor levelColor(int level) {
 	switch (level) {
-	case 1:
-		ofSetColor(ofColor::blue);
-		break;
-	case 2:
-		ofSetColor(ofColor::red);
-		break;
-	case 3:
-		ofSetColor(ofColor::green);
-		break;
-	case 4:
-		ofSetColor(ofColor::cyan);
-		break;
-	case 5:
-		ofSetColor(ofColor::brown);
-		break;
-	case 6:
-		ofSetColor(ofColor::purple);
-		break;
-	case 7:
-		ofSetColor(ofColor::orange);
-		break;
-	case 8:
-		ofSetColor(ofColor::pink);
-		break;
-	case 9:
-		ofSetColor(ofColor::yellow);
-		break;
-	default:
-		ofSetColor(ofColor::white);
-		break;
-	}
-
-	if (level == numLevels) {
-		drawBox(node.box);
+	case 1: return ofColor::blue;
+	case 2: return ofColor::red;
+	case 3: return ofColor::green;
+	case 4: return ofColor::cyan;
+	case 5: return ofColor::brown;
+	case 6: return ofColor::purple;
+	case 7: return ofColor::orange;
+	case 8: return ofColor::pink;
+	case 9: return ofColor::yellow;
+	default: return ofColor::white;
 	}
+}
 
-	level++;
-	for (int i = 0; i < node.children.size(); i++) {
-		draw(node.children[i], numLevels, level);
+// append the 12 edges of a box to a line mesh
+//
+void Octree::addBoxLines(ofMesh & lines, const Box & box) {
+	static const ofIndexType edges[24] = {
+		0, 1, 1, 3, 3, 2, 2, 0,		// bottom (y min)
+		4, 5, 5, 7, 7, 6, 6, 4,		// top
+		0, 4, 1, 5, 2, 6, 3, 7		// sides
+	};
+	Vector3 lo = box.min(), hi = box.max();
+	ofIndexType base = lines.getNumVertices();
+	for (int i = 0; i < 8; i++) {
+		lines.addVertex(glm::vec3(i & 1 ? hi.x() : lo.x(), i & 4 ? hi.y() : lo.y(), i & 2 ? hi.z() : lo.z()));
 	}
+	for (int i = 0; i < 24; i++) lines.addIndex(base + edges[i]);
 }
 
-// Optional
+//  Walk the tree once, adding every node's box to the line mesh for its level
+//  and every leaf to the leaf mesh.
 //
-void Octree::drawLeafNodes(TreeNode & node) {
+void Octree::buildDebugMeshes() {
+	levelMeshes.clear();
+	leafMesh.clear();
+	leafMesh.setMode(OF_PRIMITIVE_LINES);
+	leafMesh.setUsage(GL_STATIC_DRAW);
+
+	vector<pair<const TreeNode *, int>> stack;
+	stack.push_back(make_pair(&root, 0));
+	while (!stack.empty()) {
+		const TreeNode *node = stack.back().first;
+		int depth = stack.back().second;
+		stack.pop_back();
+		if (depth == levelMeshes.size()) {
+			levelMeshes.push_back(ofVboMesh());
+			levelMeshes.back().setMode(OF_PRIMITIVE_LINES);
+			levelMeshes.back().setUsage(GL_STATIC_DRAW);
+		}
+		addBoxLines(levelMeshes[depth], node->box);
+		if (node->children.empty()) addBoxLines(leafMesh, node->box);
+		for (int i = 0; i < node->children.size(); i++) stack.push_back(make_pair(&node->children[i], depth + 1));
+	}
+	bDebugMeshesDirty = false;
+}
 
+//  draw:  boxes of the nodes "numLevels - level" levels below the root (the
+//         root is at "level"), one draw call per level.
+//
+void Octree::draw(int numLevels, int level) {
+	if (bDebugMeshesDirty) buildDebugMeshes();
+	int depth = numLevels - level;
+	if (depth < 0 || depth >= levelMeshes.size()) return;
+	ofSetColor(levelColor(numLevels));
+	levelMeshes[depth].draw();
+}
 
+void Octree::drawLeafNodes() {
+	if (bDebugMeshesDirty) buildDebugMeshes();
+	leafMesh.draw();
 }
 
 
@@ -12,6 +12,12 @@
 #include "ofMain.h"
 #include "box.h"
 #include "ray.h"
+#include "MeshWeld.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCTREE_SSE2
+#endif
 
 
 
@@ -21,6 +27,36 @@ public:
 	vector<int> points;
 	vector<TreeNode> children;
 	bool intersects;
+	TreeNode *parent = NULL;	// set once the tree is built
+	int first = -1;				// leaf: where its point coordinates start in Octree::leafX/Y/Z
+};
+
+// Per query-owner traversal state for queries that repeat every frame from
+// nearly the same place (lander collision box, altitude ray).  Box queries
+// restart from the cached node and only climb toward the root when they leave
+// it, returning the same leaves as from the root.  Ray queries always start
+// at the root (see Octree::intersect) and only record nodesVisited.
+// Holds pointers into the tree, so reset() it whenever the octree is rebuilt.
+//
+class OctreeCursor {
+public:
+	void reset() { node = NULL; }
+
+	const TreeNode *node = NULL;	// deepest node enclosing the last box query
+	int nodesVisited = 0;			// nodes tested by the last query
+};
+
+// (mesh vertex index, squared distance) returned by proximity queries
+//
+typedef pair<int, float> PointHit;
+
+// Work space for proximity queries.  Keep one per caller and pass it to every
+// query so repeated calls reuse its storage instead of allocating.
+//
+class OctreeQueryScratch {
+public:
+	vector<pair<float, const TreeNode *>> nodeHeap;
+	vector<const TreeNode *> nodeStack;
 };
 
 class Octree {
@@ -28,25 +64,85 @@ public:
 	
 	void create(const ofMesh & mesh, int numLevels);
 	void subdivide(const ofMesh & mesh, TreeNode & node, int numLevels, int level);
-	bool intersect(const Ray &, const TreeNode & node, TreeNode & nodeRtn);
-	bool intersect(Box &, TreeNode & node, vector<Box> & boxListRtn);
-	void draw(TreeNode & node, int numLevels, int level);
-	void draw(int numLevels, int level) {
-		draw(root, numLevels, level);
-	}
-	void drawLeafNodes(TreeNode & node);
+	bool intersect(const Ray &, const TreeNode & node, TreeNode & nodeRtn) const;
+	bool intersect(const Box &, const TreeNode & node, vector<Box> & boxListRtn) const;
+	const TreeNode * intersect(const Ray &, OctreeCursor & cursor) const;
+	bool intersect(const Box &, OctreeCursor & cursor, vector<Box> & boxListRtn) const;
+	int nearest(const glm::vec3 & p, int k, OctreeQueryScratch & scratch, vector<PointHit> & hitsRtn) const;
+	int withinRadius(const glm::vec3 & p, float radius, OctreeQueryScratch & scratch, vector<PointHit> & hitsRtn) const;
+	int pointsInBox(const Box & box, OctreeQueryScratch & scratch, vector<int> & pointsRtn) const;
+	bool occluded(const glm::vec3 & origin, const glm::vec3 & dir, float tMax, float radius, OctreeQueryScratch & scratch) const;
+	void draw(int numLevels, int level);
+	void drawLeafNodes();
 	static void drawBox(const Box &box);
 	static Box meshBounds(const ofMesh &);
+	static float distance2(const Box & box, const glm::vec3 & p);
 	int getMeshPointsInBox(const ofMesh &mesh, const vector<int> & points, Box & box, vector<int> & pointsRtn);
 	int getMeshFacesInBox(const ofMesh &mesh, const vector<int> & faces, Box & box, vector<int> & facesRtn);
-	void subDivideBox8(const Box &b, vector<Box> & boxList);
+	static void subDivideBox8(const Box &b, vector<Box> & boxList);
+
+	// subDivideBox8 index of the octant from its x, z and y "upper half"
+	// bits (x | z << 1 | y << 2); shared by every octree layout here
+	//
+	static const uint8_t octantOrder[8];
+
+	void linkParents(TreeNode & node);
+	bool save(const string & path) const;
+	bool load(const string & path);
+	size_t memoryUsage() const;
+	static int countNodes(const TreeNode & node);
+	int closestPoint(const TreeNode & leaf, const Ray & ray) const;
 
 	ofMesh mesh;
 	TreeNode root;
 	bool bUseFaces = false;
 
+	// vertices closer than weldEpsilon are indexed once.  Leaf points are
+	// representative mesh vertex indices (weldUnique); weldRemap maps every
+	// mesh vertex to its slot in weldUnique.
+	//
+	float weldEpsilon = 1e-5;
+	vector<int> weldRemap;
+	vector<int> weldUnique;
+
+	// build termination.  Leaves hold up to leafSize points; nodes narrower
+	// than minExtent are not split.  With leafSize > 1, nodes of up to
+	// 4 * leafSize points also stay leaves when the estimated query cost of
+	// splitting (traversalCost per child visited, pointCost per point tested)
+	// is no better than testing all their points.
+	//
+	int leafSize = 1;
+	float minExtent = 0;
+	float traversalCost = 4;
+	float pointCost = 1;
+
 	// debug;
 	//
 	int strayVerts= 0;
 	int numLeaf = 0;
+	uint64_t buildMicros = 0;	// time taken by the last create()
+
+private:
+	void classifyPoints(const ofMesh & mesh, const vector<int> & points, const Vector3 & center, vector<uint8_t> & octantsRtn);
+	vector<float> gatherX, gatherY, gatherZ;	// build scratch
+	vector<uint8_t> octants;
+
+	// coordinates of every leaf's points, flat and in leaf order, so queries
+	// test the points of a leaf four at a time
+	//
+	void packLeaves(TreeNode & node);
+	int leafPointsInBox(const TreeNode & leaf, const Box & box, vector<int> * pointsRtn) const;
+	vector<float> leafX, leafY, leafZ;
+
+	// debug view: one line mesh per level and one for the leaves, built on
+	// first draw after create() or load()
+	//
+	void buildDebugMeshes();
+	static void addBoxLines(ofMesh & lines, const Box & box);
+	vector<ofVboMesh> levelMeshes;
+	ofVboMesh leafMesh;
+	bool bDebugMeshesDirty = true;
+
+	const TreeNode * findLeaf(const Ray &, const TreeNode & node, int & visited) const;
+	void collectLeaves(const Box &, const TreeNode & node, vector<Box> & boxListRtn, int & visited) const;
 };
\ No newline at end of file
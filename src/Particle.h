@@ -26,5 +26,6 @@ public:
 	string name =  "particle";
 
 	int radius = 2;
+	uint32_t serial = 0;	// set by ParticleList::add, increases along the list
 };
 
@@ -0,0 +1,165 @@
+#include "Profiler.h"
+
+#ifdef LANDER_PROFILE
+
+#include <fstream>
+#include <map>
+
+Profiler & Profiler::get() {
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Profiler() {
+	epoch = std::chrono::steady_clock::now();
+}
+
+//  threadRing:  the calling thread's ring.  A thread takes a ring left by
+//               an exited thread if there is one (its undrained samples are
+//               still drained), otherwise adds a new one.
+//
+Profiler::Ring * Profiler::threadRing() {
+	struct Owner {
+		Ring *ring = NULL;
+		~Owner() { if (ring) ring->free.store(true, std::memory_order_release); }
+	};
+	thread_local Owner owner;
+	if (!owner.ring) {
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for (auto & ring : rings) {
+			if (ring->free.load(std::memory_order_acquire)) {
+				ring->free.store(false, std::memory_order_relaxed);
+				owner.ring = ring.get();
+				break;
+			}
+		}
+		if (!owner.ring) {
+			rings.push_back(unique_ptr<Ring>(new Ring()));
+			owner.ring = rings.back().get();
+			owner.ring->thread = rings.size() - 1;
+		}
+	}
+	return owner.ring;
+}
+
+// single producer: only the owning thread moves head
+//
+void Profiler::record(const char *name, uint64_t start, uint64_t end) {
+	Ring *ring = threadRing();
+	uint32_t head = ring->head.load(std::memory_order_relaxed);
+	if (head - ring->tail.load(std::memory_order_acquire) == ringSize) {
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	ProfileSample & s = ring->samples[head & (ringSize - 1)];
+	s.name = name;
+	s.start = start;
+	s.end = end;
+	s.thread = ring->thread;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+//  endFrame:  drain every thread's ring and close the frame.  Samples from
+//             other threads land in the frame in which they were drained.
+//
+void Profiler::endFrame() {
+	uint64_t t = now();
+	{
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for (auto & ring : rings) {
+			uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+			uint32_t head = ring->head.load(std::memory_order_acquire);
+			for (; tail != head; tail++) pending.push_back(ring->samples[tail & (ringSize - 1)]);
+			ring->tail.store(tail, std::memory_order_release);
+			dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+		}
+	}
+	Frame frame;
+	frame.start = frameStart;
+	frame.end = t;
+	frame.samples.swap(pending);
+	frames.push_back(std::move(frame));
+	while (frames.size() > historyFrames) frames.pop_front();
+	frameStart = t;
+}
+
+//  drawOverlay:  the sections with the most time per frame over the last
+//                overlayFrames frames, slowest first.
+//
+void Profiler::drawOverlay(float x, float y, int numSections) const {
+	map<string, pair<double, int>> totals;		// ms, calls
+	int n = std::min((int)frames.size(), overlayFrames);
+	double frameMs = 0;
+	for (int i = frames.size() - n; i < frames.size(); i++) {
+		frameMs += (frames[i].end - frames[i].start) / 1e6;
+		for (const ProfileSample & s : frames[i].samples) {
+			auto & total = totals[s.name];
+			total.first += (s.end - s.start) / 1e6;
+			total.second++;
+		}
+	}
+	if (n == 0) return;
+	vector<pair<double, string>> sorted;
+	for (auto & t : totals) sorted.push_back(make_pair(t.second.first / n, t.first));
+	sort(sorted.rbegin(), sorted.rend());
+
+	string text = "frame " + ofToString(frameMs / n, 2) + " ms";
+	if (dropped) text += " (" + ofToString(dropped) + " dropped)";
+	text += "\n";
+	for (int i = 0; i < sorted.size() && i < numSections; i++) {
+		text += ofToString(sorted[i].first, 3) + " ms  " + sorted[i].second + "\n";
+	}
+	ofSetColor(ofColor::white);
+	ofDrawBitmapString(text, x, y);
+}
+
+//  exportCsv:  one row per frame, one column per section (ms summed over the
+//              frame).
+//
+bool Profiler::exportCsv(const string & path) const {
+	map<string, int> columns;
+	for (const Frame & f : frames) {
+		for (const ProfileSample & s : f.samples) columns.insert(make_pair(string(s.name), 0));
+	}
+	int c = 0;
+	for (auto & col : columns) col.second = c++;
+
+	ofstream out(path);
+	if (!out) return false;
+	out << "frame,frame_ms";
+	for (auto & col : columns) out << "," << col.first;
+	out << "\n";
+	vector<double> ms(columns.size());
+	for (int i = 0; i < frames.size(); i++) {
+		std::fill(ms.begin(), ms.end(), 0.0);
+		for (const ProfileSample & s : frames[i].samples) ms[columns[s.name]] += (s.end - s.start) / 1e6;
+		out << i << "," << (frames[i].end - frames[i].start) / 1e6;
+		for (double v : ms) out << "," << v;
+		out << "\n";
+	}
+	return (bool)out;
+}
+
+//  exportChromeTrace:  complete ("X") events in the Trace Event format, for
+//                      chrome://tracing or Perfetto.  Frames are on track 0,
+//                      each profiled thread on its own track after that.
+//
+bool Profiler::exportChromeTrace(const string & path) const {
+	ofstream out(path);
+	if (!out) return false;
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (const Frame & f : frames) {
+		out << (first ? "" : ",\n") << "{\"name\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+			<< f.start / 1000.0 << ",\"dur\":" << (f.end - f.start) / 1000.0 << "}";
+		first = false;
+		for (const ProfileSample & s : f.samples) {
+			out << ",\n{\"name\":\"" << s.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << s.thread + 1
+				<< ",\"ts\":" << s.start / 1000.0 << ",\"dur\":" << (s.end - s.start) / 1000.0 << "}";
+		}
+	}
+	out << "\n]}\n";
+	return (bool)out;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+//  Frame profiler.
+//
+//  PROFILE_SCOPE("name") times the rest of the enclosing block and
+//  PROFILE_FRAME() marks a frame boundary (once per frame, main thread).
+//  "name" must be a string literal or otherwise outlive the profiler.  The
+//  macros compile to nothing and the Profiler class doesn't exist unless
+//  LANDER_PROFILE is defined (see config.make), so code calling Profiler
+//  directly goes inside #ifdef LANDER_PROFILE too.
+//
+//  Each thread writes its samples into its own fixed size ring without locks;
+//  the main thread drains every ring at the frame boundary, so timers can be
+//  used on the loader and parser threads too.  Samples that arrive while a
+//  ring is full are dropped and counted.  A thread's ring is handed to the
+//  next new thread when it exits, so short lived threads don't pile up rings.
+//
+#ifdef LANDER_PROFILE
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::get().endFrame()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FRAME()
+#endif
+
+#ifdef LANDER_PROFILE
+
+struct ProfileSample {
+	const char *name;
+	uint64_t start;		// ns since the profiler started
+	uint64_t end;
+	int thread;			// ring index, assigned in order of first use
+};
+
+class Profiler {
+public:
+	static Profiler & get();
+
+	void record(const char *name, uint64_t start, uint64_t end);
+	uint64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	void endFrame();
+	void drawOverlay(float x, float y, int numSections = 8) const;
+	bool exportCsv(const string & path) const;
+	bool exportChromeTrace(const string & path) const;
+
+	int historyFrames = 600;	// frames kept for export
+	int overlayFrames = 60;		// frames averaged for the overlay
+	size_t dropped = 0;
+
+private:
+	Profiler();
+
+	static const uint32_t ringSize = 4096;		// power of 2
+	struct Ring {
+		ProfileSample samples[ringSize];
+		std::atomic<uint32_t> head { 0 };		// written by the owning thread
+		std::atomic<uint32_t> tail { 0 };		// written by the draining thread
+		std::atomic<uint32_t> dropped { 0 };
+		std::atomic<bool> free { false };		// owning thread has exited
+		int thread = 0;
+	};
+	Ring * threadRing();
+
+	struct Frame {
+		uint64_t start, end;
+		vector<ProfileSample> samples;
+	};
+
+	std::chrono::steady_clock::time_point epoch;
+	std::mutex ringsMutex;			// taken only when a thread first records
+	vector<unique_ptr<Ring>> rings;
+	std::deque<Frame> frames;
+	uint64_t frameStart = 0;
+	vector<ProfileSample> pending;	// drained samples for the current frame
+};
+
+class ProfileScope {
+public:
+	ProfileScope(const char *name) : name(name), start(Profiler::get().now()) {}
+	~ProfileScope() {
+		Profiler & profiler = Profiler::get();
+		profiler.record(name, start, profiler.now());
+	}
+private:
+	const char *name;
+	uint64_t start;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "SimFarm.h"
+#include <thread>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// shared between the parent and the workers
+//
+struct FarmShared {
+	std::atomic<int> next;
+};
+
+struct FarmSlot {
+	LandingTotals totals;
+	uint64_t privateKB;
+	int done;
+};
+
+static_assert(std::atomic<int>::is_always_lock_free, "the rollout counter must work across processes");
+
+// private dirty pages of this process, KB
+//
+static size_t privateMemoryKB() {
+	ifstream in("/proc/self/smaps_rollup");
+	string line;
+	size_t total = 0;
+	while (getline(in, line)) {
+		if (line.compare(0, 14, "Private_Dirty:") == 0) total += atol(line.c_str() + 14);
+	}
+	return total;
+}
+
+bool SimFarm::setup(const string & imagePath, const glm::vec3 & landerMin, const glm::vec3 & landerMax,
+	const vector<glm::vec3> & landingZones, float tickRate) {
+	if (!image.map(imagePath)) {
+		cout << "Error: can't map terrain image " << imagePath << endl;
+		return false;
+	}
+	estimator.setup(&index, NULL, landerMin, landerMax, landingZones, tickRate);
+	return true;
+}
+
+LandingEstimate SimFarm::run(const LandingScenario & scenario, int numWorkers) {
+	workerPrivateKB.clear();
+#ifdef _WIN32
+	cout << "Error: the simulation farm needs fork()" << endl;
+	return LandingEstimate();
+#else
+	if (image.empty()) {
+		cout << "Error: simulation farm has no terrain" << endl;
+		return LandingEstimate();
+	}
+	int n = numWorkers > 0 ? numWorkers : std::max(1, (int)std::thread::hardware_concurrency());
+	size_t bytes = sizeof(FarmShared) + n * sizeof(FarmSlot);
+	void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		cout << "Error: can't map shared memory for the simulation farm" << endl;
+		return LandingEstimate();
+	}
+	FarmShared *shared = new (mem) FarmShared;
+	shared->next = 0;
+	FarmSlot *slots = (FarmSlot *)(shared + 1);
+	for (int i = 0; i < n; i++) new (&slots[i]) FarmSlot();
+
+	// workers exit straight from the fork with _exit(), skipping the
+	// parent's atexit handlers and stream flushes
+	//
+	cout.flush();
+	uint64_t start = ofGetElapsedTimeMicros();
+	vector<pid_t> workers;
+	for (int i = 0; i < n; i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			estimator.worker(scenario, shared->next, slots[i].totals);
+			slots[i].privateKB = privateMemoryKB();
+			slots[i].done = 1;
+			_exit(0);
+		}
+		if (pid < 0) {
+			cout << "Error: fork failed after " << i << " workers" << endl;
+			break;
+		}
+		workers.push_back(pid);
+	}
+
+	// a failed fork leaves its rollouts to the workers that did start
+	//
+	if (workers.empty()) estimator.worker(scenario, shared->next, slots[0].totals);
+	for (pid_t pid : workers) {
+		int status;
+		waitpid(pid, &status, 0);
+	}
+	double seconds = (ofGetElapsedTimeMicros() - start) / 1e6;
+
+	// a worker that died took an unknown number of claimed rollouts with it,
+	// so the totals no longer cover scenario.rollouts: fail the whole run
+	//
+	vector<LandingTotals> totals;
+	bool failed = false;
+	for (int i = 0; i < std::max(1, (int)workers.size()); i++) {
+		if (!workers.empty() && !slots[i].done) {
+			cout << "Error: simulation farm worker " << i << " didn't finish" << endl;
+			failed = true;
+			continue;
+		}
+		totals.push_back(slots[i].totals);
+		workerPrivateKB.push_back(slots[i].privateKB);
+	}
+	munmap(mem, bytes);
+	if (failed) {
+		workerPrivateKB.clear();
+		return LandingEstimate();
+	}
+	return LandingEstimator::summarize(scenario, totals, seconds);
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ofMain.h"
+#include "SpatialIndex.h"
+#include "LandingEstimator.h"
+
+//  Landing rollouts spread over forked worker processes that all read one
+//  terrain image.
+//
+//  setup() maps a CompactOctree image (written once by "--farm" from the
+//  terrain mesh), so every worker forked from this process sees the same
+//  read-only pages: adding a worker costs a Simulation and its stack, not
+//  another copy of the mesh and octree.  Rollouts are handed out from a
+//  counter in shared memory in the same batches LandingEstimator threads
+//  use, and each worker leaves its totals in a shared slot for run() to
+//  combine.  Results don't depend on the number of workers, and match
+//  LandingEstimator::run() only when that runs on the same index: here
+//  ground height comes from a ray through the quantized CompactOctree,
+//  while the in-game estimator reads the height field wherever it's baked,
+//  so the two can differ slightly.
+//
+//  POSIX only (fork); elsewhere run() reports an error.
+//
+class SimFarm {
+public:
+	bool setup(const string & imagePath, const glm::vec3 & landerMin, const glm::vec3 & landerMax,
+		const vector<glm::vec3> & landingZones, float tickRate = 60);
+	// 0 workers: one per core.  Returns an empty estimate (no rollouts) if
+	// the run fails, including when a worker dies before finishing.
+	//
+	LandingEstimate run(const LandingScenario & scenario, int numWorkers = 0);
+
+	// private (copied on write) memory of each worker at exit, KB; 0 where
+	// /proc/self/smaps_rollup can't be read
+	//
+	vector<size_t> workerPrivateKB;
+
+	const CompactOctree & terrain() const { return image; }
+
+private:
+	CompactOctree image;
+	CompactOctreeIndex index { image };
+	LandingEstimator estimator;
+};
@@ -0,0 +1,363 @@
+#include "Simulation.h"
+#include "Profiler.h"
+
+static float randomFloat(float a, float b) {
+	return a + (b - a) * ((float)rand() / (float)RAND_MAX);
+}
+
+static void explode(glm::vec3 pos, Emitter & em) {
+	for (int x = 0; x < 300; x++) {
+		Particle child;
+		child.birthtime = ofGetElapsedTimeMillis();
+		child.lifespan = 1000;
+		child.pos = pos;
+		child.velocity = glm::vec3(randomFloat(-3000, 3000), randomFloat(-3000, 3000), randomFloat(-3000, 3000));
+		child.scale = glm::vec3(0.15, 0.15, 0.15);
+		em.sys->add(child);
+	}
+}
+
+static void thrust(glm::vec3 pos, Emitter & em) {
+	for (int x = 0; x < 10; x++) {
+		Particle child;
+		child.radius = 1;
+		child.birthtime = ofGetElapsedTimeMillis();
+		child.lifespan = 50;
+		child.pos = pos;
+		child.velocity = glm::vec3(randomFloat(-30, 30), randomFloat(-300, 0), randomFloat(-30, 30));
+		child.scale = glm::vec3(0.1, 0.1, 0.1);
+		em.sys->add(child);
+	}
+}
+
+Simulation::~Simulation() {
+	stop();
+}
+
+//  setup:  "terrain" or "streamer" is the terrain to collide with (streamed
+//          terrain must be stepped from the main thread); "ground" gives
+//          altitude, clearance and particle bounces.
+//
+void Simulation::setup(const SpatialIndex *terrain, TerrainStreamer *streamer, const HeightField *ground,
+	const glm::vec3 & landerMin, const glm::vec3 & landerMax, const glm::vec3 & landerStart,
+	const vector<glm::vec3> & landingZones, float landingZoneSize, float tickRate) {
+	this->terrain = terrain;
+	rayTerrain = terrain;
+	if (terrain) {
+		landerContext = terrain->newContext();
+		altitudeContext = terrain->newContext();
+	}
+	this->streamer = streamer;
+	this->ground = ground;
+	this->landerMin = landerMin;
+	this->landerMax = landerMax;
+	this->landerStart = landerStart;
+	this->landingZones = landingZones;
+	this->tickRate = tickRate;
+	params.landingZoneSize = landingZoneSize;
+
+	shooter.drawable = true;
+	shooter.stepRate = tickRate;
+	shooter.start();
+	reset();
+
+	// something to draw before the first tick
+	//
+	publish(Box());
+}
+
+void Simulation::reset() {
+	shipAcceleration = -(params.gravity / std::pow(tickRate, 2));
+	shipAccelerationX = (params.lateralThrust / std::pow(tickRate, 2));
+	shipAccelerationZ = (params.lateralThrust / std::pow(tickRate, 2));
+	landerPos = landerStart;
+	shipVelocity = shipVelocityX = shipVelocityZ = 0;
+	fuel = params.fuel;
+	fuelTimer = 0;
+	impact = 0;
+	landingStarted = gameOver = gameWin = false;
+	explosionActive = bResolveCollision = false;
+	shooter.sys->particles.clear();
+	shooter.pos = landerPos;
+}
+
+//  restart:  new landing from pos, already moving at velocity (units/s)
+//
+void Simulation::restart(const glm::vec3 & pos, const glm::vec3 & velocity) {
+	reset();
+	keymap.clear();
+	landerPos = pos;
+	shooter.pos = pos;
+	shipVelocityX = velocity.x / tickRate;
+	shipVelocity = velocity.y / tickRate;
+	shipVelocityZ = velocity.z / tickRate;
+	landingStarted = true;
+}
+
+void Simulation::setControls(bool thrust, int x, int z) {
+	keymap[' '] = thrust;
+	keymap[OF_KEY_LEFT] = x < 0;
+	keymap[OF_KEY_RIGHT] = x > 0;
+	keymap[OF_KEY_UP] = z < 0;
+	keymap[OF_KEY_DOWN] = z > 0;
+}
+
+float Simulation::random(float a, float b) {
+	return std::uniform_real_distribution<float>(a, b)(rng);
+}
+
+void Simulation::start() {
+	if (worker.joinable() || streamer) return;
+	running = true;
+	worker = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+	running = false;
+	if (worker.joinable()) worker.join();
+}
+
+void Simulation::step() {
+	if (!worker.joinable()) tick();
+}
+
+//  Fixed rate loop.  If the thread falls far behind (debugger, machine
+//  asleep) it drops the missed ticks rather than trying to catch up.
+//
+void Simulation::run() {
+	auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / tickRate));
+	auto next = std::chrono::steady_clock::now();
+	while (running) {
+		tick();
+		next += period;
+		auto now = std::chrono::steady_clock::now();
+		if (next < now - period * 15) next = now;
+		std::this_thread::sleep_until(next);
+	}
+}
+
+void Simulation::key(int key, bool pressed) {
+	std::lock_guard<std::mutex> guard(inputLock);
+	pendingKeys.push_back(make_pair(key, pressed));
+}
+
+void Simulation::moveLander(const glm::vec3 & p) {
+	std::lock_guard<std::mutex> guard(inputLock);
+	pendingMove = true;
+	pendingPos = p;
+}
+
+void Simulation::applyInput() {
+	vector<pair<int, bool>> keys;
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		keys.swap(pendingKeys);
+		if (pendingMove) {
+			landerPos = pendingPos;
+			pendingMove = false;
+		}
+	}
+	for (auto & k : keys) {
+		keymap[k.first] = k.second;
+		if (!k.second) continue;
+		switch (k.first) {
+		case 'a':
+			landerRotation -= rotationSpeed;
+			break;
+		case 'd':
+			landerRotation += rotationSpeed;
+			break;
+		case 'r':
+			if (gameOver || gameWin) reset();
+			break;
+		case '1':
+			landingStarted = true;
+			break;
+		}
+	}
+}
+
+void Simulation::setRayTerrain(const SpatialIndex *index) {
+	rayTerrain = index;
+	if (index) altitudeContext = index->newContext();
+}
+
+void Simulation::tick() {
+	if (headless) {
+		ticks++;
+		Box bounds(landerPos + landerMin, landerPos + landerMax);
+		collisions.clear();
+		if (terrain) terrain->overlapCells(bounds, *landerContext, collisions);
+		stepLander(bounds);
+		return;
+	}
+
+	PROFILE_SCOPE("simulation");
+	applyInput();
+	ticks++;
+
+	Box bounds(landerPos + landerMin, landerPos + landerMax);
+	collisions.clear();
+	{
+		PROFILE_SCOPE("collision query");
+		if (streamer) {
+			streamer->update(landerPos);
+			streamer->intersect(bounds, collisions);
+		}
+		else if (terrain) terrain->overlapCells(bounds, *landerContext, collisions);
+	}
+	{
+		PROFILE_SCOPE("emitter update");
+		shooter.update();
+	}
+	{
+		PROFILE_SCOPE("particle collision");
+		if (ground) shooter.sys->collide(*ground);
+	}
+	stepLander(bounds);
+	publish(bounds);
+}
+
+void Simulation::stepLander(const Box & bounds) {
+	thrusting = false;
+	if (landingStarted) {
+		if (collisions.size() < 10) {
+			if (keymap[32] && fuel > 0.0f) {
+				shipVelocity += (params.thrust / std::pow(tickRate, 2));
+				if (!headless) thrust(landerPos, shooter);
+				thrusting = true;
+				fuelTimer += 1.0f / tickRate;
+				if (fuelTimer >= 1.0f) {
+					fuelTimer -= 1.0f;
+					fuel = std::max(0.0f, fuel - 1.0f);
+				}
+			}
+			if (keymap[OF_KEY_LEFT]) shipVelocityX -= shipAccelerationX;
+			if (keymap[OF_KEY_RIGHT]) shipVelocityX += shipAccelerationX;
+			if (keymap[OF_KEY_UP]) shipVelocityZ -= shipAccelerationZ;
+			if (keymap[OF_KEY_DOWN]) shipVelocityZ += shipAccelerationZ;
+
+			shipVelocity += shipAcceleration;
+
+			float turbulenceX = random(-params.turbulence, params.turbulence);
+			float turbulenceZ = random(-params.turbulence, params.turbulence);
+			shooter.pos = landerPos;
+			landerPos += glm::vec3(shipVelocityX + turbulenceX, shipVelocity, shipVelocityZ + turbulenceZ);
+		}
+		else if (std::abs(shipVelocity) > params.crashSpeed / tickRate) {
+			if (!headless) explode(landerPos, shooter);
+			crashes++;
+			impact = std::abs(shipVelocity);
+			explosionVelocity = glm::vec3(random(-150, 150), random(200, 300), random(-150, 150));
+			explosionActive = true;
+			landingStarted = false;
+			gameOver = true;
+		}
+	}
+
+	if (explosionActive) {
+		explosionVelocity += glm::vec3(0, -0.2, 0);
+		landerPos += explosionVelocity / tickRate;
+	}
+
+	if (bResolveCollision) {
+		landerPos += collisionDirection * collisionSpeed;
+		if (collisions.size() < 10) bResolveCollision = false;
+	}
+	else if (collisions.size() >= 10) {
+		float impactForce = std::abs(shipVelocity);
+		if (!gameOver) impact = impactForce;
+		bool flat = !params.requireFlatGround || landingMap == NULL || landingMap->landable(bounds);
+		if (impactForce <= params.landingSpeed / tickRate && flat) {
+			for (auto & zone : landingZones) {
+				if (glm::distance(landerPos, zone) < params.landingZoneSize) {
+					gameWin = true;
+					landingStarted = false;
+					return;
+				}
+			}
+		}
+		collisionDirection = glm::vec3(0, impactForce * 1.2f, 0);
+		bumps++;
+		bResolveCollision = true;
+		shipVelocity = 0;
+		shipVelocityX = 0;
+		shipVelocityZ = 0;
+	}
+}
+
+//  Fill the back snapshot and publish it.  The particle vector keeps its
+//  capacity from the last time this slot was written, so copying it rarely
+//  allocates.
+//
+void Simulation::publish(const Box & bounds) {
+	SimSnapshot & s = snapshots.writeBuffer();
+	s.tick = ticks;
+	s.landerPos = landerPos;
+	s.landerRotation = landerRotation;
+	s.shipVelocity = shipVelocity;
+	s.fuel = fuel;
+	s.collisions = collisions.size();
+	s.nodesVisited = landerContext ? landerContext->nodesVisited : 0;
+	s.landingStarted = landingStarted;
+	s.gameOver = gameOver;
+	s.gameWin = gameWin;
+	s.thrusting = thrusting;
+	s.crashes = crashes;
+	s.bumps = bumps;
+
+	if (telemetry && ground) {
+		PROFILE_SCOPE("altitude");
+		// a ray terrain set with setRayTerrain() takes priority over the
+		// height field and the streamer
+		//
+		bool rayAltitude = rayTerrain && rayTerrain != terrain;
+		if (!rayAltitude && ground->isBaked()) s.altitude = ground->altitude(landerPos);
+		else if (!rayAltitude && streamer) {
+			Ray downRay(landerPos, Vector3(0, -1, 0));
+			glm::vec3 p;
+			if (streamer->intersect(downRay, p)) s.altitude = landerPos.y - p.y;
+		}
+		else if (rayTerrain) {
+			Ray downRay(landerPos, Vector3(0, -1, 0));
+			SpatialHit hit;
+			if (rayTerrain->raycast(downRay, *altitudeContext, hit)) s.altitude = landerPos.y - hit.point.y;
+		}
+		s.clearance = ground->clearance(bounds);
+	}
+	if (telemetry && landingMap && landingMap->isBuilt()) {
+		s.landable = landingMap->landable(bounds);
+		glm::vec3 site;
+		s.siteDistance = -1;
+		if (landingMap->nearestSite(landerPos, site)) {
+			float dx = site.x - landerPos.x, dz = site.z - landerPos.z;
+			s.siteDistance = sqrt(dx * dx + dz * dz);
+		}
+	}
+
+	// follow cameras (modes as in ofApp::CamMode)
+	//
+	s.followCamera = true;
+	switch (cameraMode) {
+	case 1:		// TRACK_CAM
+		s.cameraEye = landerPos + glm::vec3(0, 5, 10);
+		s.cameraTarget = landerPos;
+		break;
+	case 2: {	// BOTTOM_CAM
+		glm::vec3 rocketBottom = landerPos + glm::vec3(0, landerMin.y, 0);
+		s.cameraEye = rocketBottom + glm::vec3(0, 0.5f, 0);
+		s.cameraTarget = rocketBottom + glm::vec3(0, -10.0f, 0);
+		break;
+	}
+	case 3:		// TOP_CAM
+		s.cameraEye = landerPos + glm::vec3(0, 25, 0);
+		s.cameraTarget = landerPos;
+		break;
+	default:
+		s.followCamera = false;
+		break;
+	}
+
+	s.particles = shooter.sys->particles;
+	snapshots.publish();
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "ofMain.h"
+#include "SpatialIndex.h"
+#include "HeightField.h"
+#include "LandingMap.h"
+#include "TerrainStreamer.h"
+#include "Emitter.h"
+#include "TripleBuffer.h"
+#include <thread>
+#include <mutex>
+#include <random>
+
+//  Everything the renderer needs from one simulation tick.  Published whole
+//  through a TripleBuffer, so a frame always draws one consistent tick.
+//
+struct SimSnapshot {
+	uint64_t tick = 0;
+
+	glm::vec3 landerPos;
+	float landerRotation = 0;		// degrees about y
+	float shipVelocity = 0;
+	float fuel = 0;
+
+	int collisions = 0;				// terrain leaf boxes overlapping the lander
+	int nodesVisited = 0;			// index nodes the collision query visited
+	float altitude = 0;				// only when telemetry is on
+	float clearance = 0;
+	bool landable = false;			// flat ground under the lander's footprint
+	float siteDistance = -1;		// horizontal distance to the nearest landing site, -1 if none
+
+	bool landingStarted = false;
+	bool gameOver = false;
+	bool gameWin = false;
+
+	// sounds: the renderer plays a sound when its count goes up
+	//
+	bool thrusting = false;
+	int crashes = 0;
+	int bumps = 0;
+
+	// fixed camera placement, when the camera mode follows the lander
+	//
+	bool followCamera = false;
+	glm::vec3 cameraEye, cameraTarget;
+
+	vector<Particle> particles;
+};
+
+//  Tunable lander physics.  Accelerations in units/s^2, speeds in units/s,
+//  fuel in seconds of thrust.  Read by reset(), so a change takes effect when
+//  the lander next restarts.
+//
+struct LanderParams {
+	float gravity = 1.625;
+	float thrust = 10;
+	float lateralThrust = 1;
+	float fuel = 120;
+	float landingZoneSize = 15;
+	float turbulence = 0.05;		// max random sideways drift per tick
+	float crashSpeed = 4.8;			// touchdown faster than this explodes
+	float landingSpeed = 0.9;		// touchdown in a zone at most this fast wins
+	bool requireFlatGround = false;	// and, with a LandingMap, only on landable ground
+};
+
+//  Landing pads on the default terrain: in the mountains, behind the
+//  mountains and in the middle
+//
+inline vector<glm::vec3> defaultLandingZones() {
+	return { glm::vec3(50, 0.2, -179), glm::vec3(-180, 0.2, 154), glm::vec3(0, 0.2, 20) };
+}
+
+//  Lander physics, terrain collision, telemetry and exhaust particles.
+//
+//  start() runs the simulation on its own thread at tickRate ticks per
+//  second, independent of the frame rate; step() instead runs one tick on the
+//  calling thread, for lockstep runs (input recording and replay, and
+//  streamed terrain, whose tiles are installed on the main thread).  Input
+//  goes in through key() and friends, results come out as SimSnapshots.
+//
+//  A headless simulation (LandingEstimator rollouts) skips particles,
+//  profiling and snapshots.  It is stepped on the caller's thread, flown with
+//  setControls() and read back through the accessors below, which are only
+//  valid while the simulation isn't threaded.
+//
+class Simulation {
+public:
+	~Simulation();
+
+	void setup(const SpatialIndex *terrain, TerrainStreamer *streamer, const HeightField *ground,
+		const glm::vec3 & landerMin, const glm::vec3 & landerMax, const glm::vec3 & landerStart,
+		const vector<glm::vec3> & landingZones, float landingZoneSize, float tickRate);
+	void start();
+	void stop();
+	void step();
+	bool isThreaded() const { return worker.joinable(); }
+
+	// input, from the main thread
+	//
+	void key(int key, bool pressed);
+	void moveLander(const glm::vec3 & p);
+	void setCameraMode(int mode) { cameraMode = mode; }		// ofApp::CamMode
+	void setTelemetry(bool on) { telemetry = on; }
+	void setLandingMap(const LandingMap *map) { landingMap = map; }		// before start()
+	void setRayTerrain(const SpatialIndex *index);		// altitude ray, used over the height field; before start()
+
+	//  acquire:  take the newest snapshot (main thread, once per frame); it
+	//            stays valid through snapshot() until the next acquire().
+	//
+	bool acquire() { return snapshots.acquire(); }
+	const SimSnapshot & snapshot() const { return snapshots.read(); }
+	SimSnapshot & snapshot() { return snapshots.read(); }
+
+	// headless rollouts
+	//
+	void setHeadless(bool on) { headless = on; }
+	void seed(uint32_t s) { rng.seed(s); }
+	void restart(const glm::vec3 & pos, const glm::vec3 & velocity);
+	void setControls(bool thrust, int x, int z);		// x, z: -1, 0 or 1
+	const glm::vec3 & position() const { return landerPos; }
+	glm::vec3 velocity() const { return glm::vec3(shipVelocityX, shipVelocity, shipVelocityZ) * tickRate; }
+	float fuelLeft() const { return fuel; }
+	bool landed() const { return gameWin; }
+	bool crashed() const { return gameOver; }
+	int touchdowns() const { return bumps; }			// running count of contacts that didn't land
+	float impactSpeed() const { return impact * tickRate; }	// vertical speed at the last contact
+
+	float tickRate = 60;
+	LanderParams params;
+
+private:
+	void run();
+	void tick();
+	void applyInput();
+	void reset();
+	void stepLander(const Box & bounds);
+	float random(float a, float b);
+	void publish(const Box & bounds);
+
+	const SpatialIndex *terrain = NULL;
+	const SpatialIndex *rayTerrain = NULL;
+	TerrainStreamer *streamer = NULL;
+	const HeightField *ground = NULL;
+	const LandingMap *landingMap = NULL;
+	glm::vec3 landerMin, landerMax;			// model space bounds
+	glm::vec3 landerStart;
+	vector<glm::vec3> landingZones;
+	bool headless = false;
+
+	// simulation thread state
+	//
+	uint64_t ticks = 0;
+	glm::vec3 landerPos;
+	float landerRotation = 0;
+	float shipVelocity = 0, shipVelocityX = 0, shipVelocityZ = 0;
+	float shipAcceleration = 0, shipAccelerationX = 0, shipAccelerationZ = 0;
+	float fuel = 120, fuelTimer = 0;
+	float impact = 0;
+	bool landingStarted = false, gameOver = false, gameWin = false;
+	bool explosionActive = false, bResolveCollision = false;
+	glm::vec3 explosionVelocity, collisionDirection;
+	float collisionSpeed = 0.1;
+	float rotationSpeed = 1.0;
+	bool thrusting = false;
+	int crashes = 0, bumps = 0;
+	map<int, bool> keymap;
+	std::mt19937 rng;
+	Emitter shooter;
+	std::unique_ptr<SpatialContext> landerContext, altitudeContext;
+	vector<Box> collisions;
+
+	// input from the main thread
+	//
+	std::mutex inputLock;
+	vector<pair<int, bool>> pendingKeys;
+	bool pendingMove = false;
+	glm::vec3 pendingPos;
+	std::atomic<int> cameraMode { 0 };
+	std::atomic<bool> telemetry { false };
+
+	TripleBuffer<SimSnapshot> snapshots;
+	std::thread worker;
+	std::atomic<bool> running { false };
+};
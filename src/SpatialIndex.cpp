@@ -0,0 +1,210 @@
+#include "SpatialIndex.h"
+#include "MeshWeld.h"
+
+std::unique_ptr<SpatialContext> SpatialIndex::newContext() const {
+	return std::unique_ptr<SpatialContext>(new SpatialContext());
+}
+
+bool intersectTriangle(const glm::vec3 & o, const glm::vec3 & dir, const glm::vec3 & a, const glm::vec3 & b,
+	const glm::vec3 & c, float & tRtn) {
+	glm::vec3 e1 = b - a, e2 = c - a;
+	glm::vec3 p = glm::cross(dir, e2);
+	float det = glm::dot(e1, p);
+	if (std::abs(det) < 1e-12f) return false;
+	float inv = 1 / det;
+	glm::vec3 s = o - a;
+	float u = glm::dot(s, p) * inv;
+	if (u < 0 || u > 1) return false;
+	glm::vec3 q = glm::cross(s, e1);
+	float v = glm::dot(dir, q) * inv;
+	if (v < 0 || u + v > 1) return false;
+	tRtn = glm::dot(e2, q) * inv;
+	return tRtn > 0;
+}
+
+// k nearest as SpatialHits from (id, squared distance) pairs
+//
+static int toHits(const vector<PointHit> & hits, const ofMesh & mesh, vector<SpatialHit> & hitsRtn) {
+	hitsRtn.resize(hits.size());
+	for (int i = 0; i < hits.size(); i++) {
+		hitsRtn[i].id = hits[i].first;
+		hitsRtn[i].point = mesh.getVertex(hits[i].first);
+		hitsRtn[i].distance = sqrt(hits[i].second);
+	}
+	return hitsRtn.size();
+}
+
+//--------------------------------------------------------------
+// octree
+
+class OctreeContext : public SpatialContext {
+public:
+	OctreeCursor rayCursor, boxCursor;
+	OctreeQueryScratch scratch;
+	vector<PointHit> hits;
+};
+
+void OctreeIndex::build(const ofMesh & mesh) {
+	octree.create(mesh, numLevels);
+}
+
+std::unique_ptr<SpatialContext> OctreeIndex::newContext() const {
+	return std::unique_ptr<SpatialContext>(new OctreeContext());
+}
+
+bool OctreeIndex::raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const {
+	OctreeContext & c = static_cast<OctreeContext &>(context);
+	const TreeNode *leaf = octree.intersect(ray, c.rayCursor);
+	c.nodesVisited = c.rayCursor.nodesVisited;
+	if (leaf == NULL) return false;
+	hitRtn.id = octree.closestPoint(*leaf, ray);
+	hitRtn.point = octree.mesh.getVertex(hitRtn.id);
+	hitRtn.distance = glm::dot(hitRtn.point - (glm::vec3)ray.origin, glm::normalize((glm::vec3)ray.direction));
+	return true;
+}
+
+int OctreeIndex::overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const {
+	OctreeContext & c = static_cast<OctreeContext &>(context);
+	return octree.pointsInBox(box, c.scratch, idsRtn);
+}
+
+int OctreeIndex::overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const {
+	OctreeContext & c = static_cast<OctreeContext &>(context);
+	int count = cellsRtn.size();
+	octree.intersect(box, c.boxCursor, cellsRtn);
+	c.nodesVisited = c.boxCursor.nodesVisited;
+	return cellsRtn.size() - count;
+}
+
+int OctreeIndex::nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const {
+	OctreeContext & c = static_cast<OctreeContext &>(context);
+	octree.nearest(p, k, c.scratch, c.hits);
+	return toHits(c.hits, octree.mesh, hitsRtn);
+}
+
+//--------------------------------------------------------------
+// compact octree
+
+class CompactOctreeContext : public SpatialContext {
+public:
+	CompactOctreeScratch scratch;
+	vector<PointHit> hits;
+	vector<glm::vec3> points;
+};
+
+void CompactOctreeIndex::build(const ofMesh & mesh) {
+	Octree octree;
+	octree.create(mesh, numLevels);
+	tree.build(octree, true);
+}
+
+std::unique_ptr<SpatialContext> CompactOctreeIndex::newContext() const {
+	return std::unique_ptr<SpatialContext>(new CompactOctreeContext());
+}
+
+bool CompactOctreeIndex::raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const {
+	if (!tree.intersect(ray, hitRtn.point, hitRtn.id)) return false;
+	hitRtn.distance = glm::dot(hitRtn.point - (glm::vec3)ray.origin, glm::normalize((glm::vec3)ray.direction));
+	return true;
+}
+
+int CompactOctreeIndex::overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const {
+	return tree.pointsInBox(box, idsRtn);
+}
+
+int CompactOctreeIndex::overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const {
+	int count = cellsRtn.size();
+	tree.intersect(box, cellsRtn);
+	return cellsRtn.size() - count;
+}
+
+int CompactOctreeIndex::nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const {
+	CompactOctreeContext & c = static_cast<CompactOctreeContext &>(context);
+	vector<PointHit> & hits = c.hits;
+	vector<glm::vec3> & points = c.points;
+	tree.nearest(p, k, c.scratch, hits, &points);
+	hitsRtn.resize(hits.size());
+	for (int i = 0; i < hits.size(); i++) {
+		hitsRtn[i].id = hits[i].first;
+		hitsRtn[i].point = points[i];
+		hitsRtn[i].distance = sqrt(hits[i].second);
+	}
+	return hitsRtn.size();
+}
+
+//--------------------------------------------------------------
+// linear scan
+
+void LinearIndex::build(const ofMesh & mesh) {
+	vertices = mesh.getVertices();
+	vector<int> remap;
+	weldVertices(mesh, Octree().weldEpsilon, remap, unique);
+	ids.resize(vertices.size());
+	for (int i = 0; i < ids.size(); i++) ids[i] = unique[remap[i]];
+	triangles.assign(mesh.getIndices().begin(), mesh.getIndices().end());
+	box = Octree::meshBounds(mesh);
+}
+
+bool LinearIndex::raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const {
+	glm::vec3 o = ray.origin;
+	glm::vec3 d = glm::normalize((glm::vec3)ray.direction);
+	float best = FLT_MAX;
+	int bestTriangle = -1;
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+		float t;
+		if (intersectTriangle(o, d, vertices[triangles[i]], vertices[triangles[i + 1]], vertices[triangles[i + 2]], t) && t < best) {
+			best = t;
+			bestTriangle = i;
+		}
+	}
+	if (bestTriangle == -1) return false;
+	hitRtn.point = o + d * best;
+	hitRtn.distance = best;
+	float closest = FLT_MAX;
+	for (int k = 0; k < 3; k++) {
+		int v = triangles[bestTriangle + k];
+		float dist = glm::distance2(vertices[v], hitRtn.point);
+		if (dist < closest) {
+			closest = dist;
+			hitRtn.id = ids[v];
+		}
+	}
+	return true;
+}
+
+int LinearIndex::overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const {
+	idsRtn.clear();
+	for (int id : unique) {
+		if (box.inside(vertices[id])) idsRtn.push_back(id);
+	}
+	sort(idsRtn.begin(), idsRtn.end());
+	return idsRtn.size();
+}
+
+int LinearIndex::overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const {
+	int count = cellsRtn.size();
+	for (int id : unique) {
+		if (box.inside(vertices[id])) cellsRtn.push_back(Box(vertices[id], vertices[id]));
+	}
+	return cellsRtn.size() - count;
+}
+
+int LinearIndex::nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const {
+	vector<PointHit> hits(unique.size());
+	for (int i = 0; i < unique.size(); i++) hits[i] = make_pair(unique[i], glm::distance2(vertices[unique[i]], p));
+	k = std::min(k, (int)hits.size());
+	partial_sort(hits.begin(), hits.begin() + k, hits.end(),
+		[](const PointHit & a, const PointHit & b) { return a.second < b.second; });
+	hitsRtn.resize(k);
+	for (int i = 0; i < k; i++) {
+		hitsRtn[i].id = hits[i].first;
+		hitsRtn[i].point = vertices[hits[i].first];
+		hitsRtn[i].distance = sqrt(hits[i].second);
+	}
+	return k;
+}
+
+size_t LinearIndex::memoryUsage() const {
+	return vertices.capacity() * sizeof(glm::vec3) + (ids.capacity() + unique.capacity()) * sizeof(int) +
+		triangles.capacity() * sizeof(uint32_t);
+}
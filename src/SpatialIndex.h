@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ofMain.h"
+#include "box.h"
+#include "ray.h"
+#include "Octree.h"
+#include "CompactOctree.h"
+#include <memory>
+
+//  One result of a SpatialIndex query
+//
+struct SpatialHit {
+	int id = -1;				// mesh vertex index (a weldUnique vertex)
+	glm::vec3 point;			// where the ray hit the surface, or the vertex
+	float distance = FLT_MAX;	// along the ray (unit direction), or from the query point
+};
+
+//  Per caller query state: traversal caches (e.g. OctreeCursor) and scratch
+//  space.  Each backend makes its own kind with newContext(); keep one per
+//  thread or per query stream (collision box, altitude ray, picking), and
+//  make new ones after the index is rebuilt.
+//
+class SpatialContext {
+public:
+	virtual ~SpatialContext() {}
+	int nodesVisited = 0;		// by the last query, where the backend counts them
+};
+
+//  Acceleration structure over the terrain mesh, so gameplay and tools can be
+//  run against different backends.  Vertices closer than Octree::weldEpsilon
+//  are indexed once, so every backend reports the same ids.  Queries are
+//  const and safe to run from several threads with separate contexts.
+//
+class SpatialIndex {
+public:
+	virtual ~SpatialIndex() {}
+	virtual const char * name() const = 0;
+	virtual void build(const ofMesh & mesh) = 0;
+	virtual std::unique_ptr<SpatialContext> newContext() const;
+
+	// the terrain surface along the ray; backends over points return their
+	// best estimate of it
+	//
+	virtual bool raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const = 0;
+
+	// vertices inside box, ascending
+	//
+	virtual int overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const = 0;
+
+	// occupied cells overlapping box, for the lander contact test (octree
+	// leaves; a zero size box per vertex inside where there are no cells)
+	//
+	virtual int overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const = 0;
+
+	// k nearest vertices, closest first
+	//
+	virtual int nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const = 0;
+
+	virtual Box bounds() const = 0;
+	virtual size_t memoryUsage() const = 0;
+};
+
+//  Octree backend.  Uses an existing Octree (the game draws and chunks the
+//  same one); build() rebuilds it with numLevels levels.
+//
+class OctreeIndex : public SpatialIndex {
+public:
+	OctreeIndex(Octree & octree, int numLevels = 20) : octree(octree), numLevels(numLevels) {}
+	const char * name() const override { return "octree"; }
+	void build(const ofMesh & mesh) override;
+	std::unique_ptr<SpatialContext> newContext() const override;
+	bool raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const override;
+	int overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const override;
+	int overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const override;
+	int nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const override;
+	Box bounds() const override { return octree.root.box; }
+	size_t memoryUsage() const override { return octree.memoryUsage(); }
+
+	Octree & octree;
+	int numLevels;
+};
+
+//  CompactOctree backend.  build() goes through a temporary Octree of
+//  numLevels levels and keeps the vertex ids.
+//
+class CompactOctreeIndex : public SpatialIndex {
+public:
+	CompactOctreeIndex(CompactOctree & tree, int numLevels = 20) : tree(tree), numLevels(numLevels) {}
+	const char * name() const override { return "compact octree"; }
+	void build(const ofMesh & mesh) override;
+	std::unique_ptr<SpatialContext> newContext() const override;
+	bool raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const override;
+	int overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const override;
+	int overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const override;
+	int nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const override;
+	Box bounds() const override { return tree.rootBox; }
+	size_t memoryUsage() const override { return tree.memoryUsage(); }
+
+	CompactOctree & tree;
+	int numLevels;
+};
+
+//  Brute force reference: scans every triangle or vertex.  Its ray hits are
+//  exact triangle intersections.
+//
+class LinearIndex : public SpatialIndex {
+public:
+	const char * name() const override { return "linear scan"; }
+	void build(const ofMesh & mesh) override;
+	bool raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const override;
+	int overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const override;
+	int overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const override;
+	int nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const override;
+	Box bounds() const override { return box; }
+	size_t memoryUsage() const override;
+
+private:
+	vector<glm::vec3> vertices;		// mesh vertices
+	vector<int> ids;				// weldUnique id of each mesh vertex
+	vector<int> unique;				// ids, once each
+	vector<uint32_t> triangles;
+	Box box;
+};
+
+//  Ray/triangle intersection (Moller-Trumbore); t along dir, hits at t > 0
+//
+bool intersectTriangle(const glm::vec3 & o, const glm::vec3 & dir, const glm::vec3 & a, const glm::vec3 & b,
+	const glm::vec3 & c, float & tRtn);
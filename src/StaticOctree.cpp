@@ -0,0 +1,338 @@
+#include "StaticOctree.h"
+#include "MeshWeld.h"
+
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+const char * StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::name() const {
+	static const string label = string("static octree (") + Primitive::label() + ", " + ofToString(sizeof(Index) * 8) +
+		" bit, leaf " + ofToString(LeafCapacity) + ", " + ofToString(MaxDepth) + " levels)";
+	return label.c_str();
+}
+
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+void StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::build(const ofMesh & mesh) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	nodes.clear();
+	prims.clear();
+	ids.clear();
+	vertices = mesh.getVertices();
+	if (vertices.size() > std::numeric_limits<Index>::max()) {
+		cout << "Error: " << name() << " can't index " << vertices.size() << " vertices" << endl;
+		vertices.clear();
+		return;
+	}
+
+	// points are the welded vertices, like Octree's; triangles keep their
+	// corners and map them to welded ids for results
+	//
+	vector<int> remap, unique;
+	weldVertices(mesh, Octree().weldEpsilon, remap, unique);
+	int n;
+	if (Primitive::corners == 1) {
+		n = unique.size();
+		corners.assign(unique.begin(), unique.end());
+		centers.resize(n);
+		for (int i = 0; i < n; i++) centers[i] = vertices[unique[i]];
+	}
+	else {
+		ids.resize(vertices.size());
+		for (int i = 0; i < ids.size(); i++) ids[i] = unique[remap[i]];
+		n = mesh.getNumIndices() / 3;
+		corners.assign(mesh.getIndices().begin(), mesh.getIndices().begin() + n * 3);
+		primMin.resize(n);
+		primMax.resize(n);
+		centers.resize(n);
+		for (int i = 0; i < n; i++) {
+			glm::vec3 a = vertices[corners[i * 3]], b = vertices[corners[i * 3 + 1]], c = vertices[corners[i * 3 + 2]];
+			primMin[i] = glm::min(a, glm::min(b, c));
+			primMax[i] = glm::max(a, glm::max(b, c));
+			centers[i] = (primMin[i] + primMax[i]) * 0.5f;
+		}
+	}
+	order.resize(n);
+	for (int i = 0; i < n; i++) order[i] = i;
+
+	Box cell = Octree::meshBounds(mesh);
+	nodes.push_back(Node());
+	nodes[0].box = cell;
+	subdivide(0, cell, 0, n, 1);
+
+	prims.resize(n * Primitive::corners);
+	for (int i = 0; i < n; i++) {
+		for (int c = 0; c < Primitive::corners; c++) prims[i * Primitive::corners + c] = corners[order[i] * Primitive::corners + c];
+	}
+	vector<int>().swap(order);
+	vector<glm::vec3>().swap(primMin);
+	vector<glm::vec3>().swap(primMax);
+	vector<glm::vec3>().swap(centers);
+	vector<uint32_t>().swap(corners);
+
+	if (nodes.size() > std::numeric_limits<Index>::max()) {
+		cout << "Error: " << name() << " needs " << nodes.size() << " nodes" << endl;
+		nodes.clear();
+		prims.clear();
+		return;
+	}
+	buildMicros = ofGetElapsedTimeMicros() - start;
+}
+
+//  subdivide:  split order[first, first + count) over the octants of "cell"
+//              and make a node for every occupied one, then recurse.  Stops
+//              where Octree::subdivide does: at LeafCapacity primitives, the
+//              level limit, or when splitting a small node doesn't pay.
+//
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+void StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::subdivide(int node, const Box & cell, int first, int count, int level) {
+	nodes[node].first = first;
+	nodes[node].count = count;
+	nodes[node].leaf = true;
+	if (level >= MaxDepth || count <= LeafCapacity) return;
+
+	Vector3 center = cell.center();
+	vector<uint8_t> octants(count);
+	int counts[8] = { 0 };
+	for (int i = 0; i < count; i++) {
+		const glm::vec3 & p = centers[order[first + i]];
+		int bits = (p.x >= center.x()) | ((p.z >= center.z()) << 1) | ((p.y >= center.y()) << 2);
+		octants[i] = Octree::octantOrder[bits];
+		counts[octants[i]]++;
+	}
+	int occupied = 0;
+	for (int c = 0; c < 8; c++) if (counts[c] > 0) occupied++;
+	if (LeafCapacity > 1 && count <= 4 * LeafCapacity) {
+		float splitCost = traversalCost * occupied + primitiveCost * count / 4;
+		if (splitCost >= primitiveCost * count) return;
+	}
+
+	// stable, so points keep Octree's order inside each leaf
+	//
+	int offset[8];
+	for (int c = 0, sum = first; c < 8; c++) {
+		offset[c] = sum;
+		sum += counts[c];
+	}
+	vector<int> sorted(count);
+	for (int i = 0; i < count; i++) sorted[offset[octants[i]]++ - first] = order[first + i];
+	copy(sorted.begin(), sorted.end(), order.begin() + first);
+
+	vector<Box> boxes;
+	Octree::subDivideBox8(cell, boxes);
+	int child = nodes.size();
+	nodes.resize(child + occupied);
+	nodes[node].first = child;
+	nodes[node].count = occupied;
+	nodes[node].leaf = false;
+	int begin = first;
+	for (int c = 0; c < 8; c++) {
+		if (counts[c] == 0) continue;
+		Box box = boxes[c];
+		if (Primitive::fitBounds) {
+			glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+			for (int i = begin; i < begin + counts[c]; i++) {
+				lo = glm::min(lo, primMin[order[i]]);
+				hi = glm::max(hi, primMax[order[i]]);
+			}
+			box = Box(Vector3(lo.x, lo.y, lo.z), Vector3(hi.x, hi.y, hi.z));
+		}
+		nodes[child].box = box;
+		subdivide(child, boxes[c], begin, counts[c], level + 1);
+		begin += counts[c];
+		child++;
+	}
+}
+
+// ray parameter where the ray enters box (between t0 and t1), or FLT_MAX
+//
+static float enterBox(const Box & box, const Ray & r, float t0, float t1) {
+	for (int k = 0; k < 3; k++) {
+		float a = (box.parameters[r.sign[k]][k] - r.origin[k]) * r.inv_direction[k];
+		float b = (box.parameters[1 - r.sign[k]][k] - r.origin[k]) * r.inv_direction[k];
+		t0 = std::max(t0, a);
+		t1 = std::min(t1, b);
+	}
+	return t0 <= t1 ? t0 : FLT_MAX;
+}
+
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+bool StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const {
+	context.nodesVisited = 0;
+	if (nodes.empty()) return false;
+	glm::vec3 o = ray.origin;
+	glm::vec3 d = glm::normalize((glm::vec3)ray.direction);
+	const int C = Primitive::corners;
+
+	if (Primitive::firstLeafHit) {
+		Index stack[stackSize];
+		int sp = 0;
+		stack[sp++] = 0;
+		while (sp > 0) {
+			const Node & n = nodes[stack[--sp]];
+			context.nodesVisited++;
+			if (!n.box.intersect(ray, -1000, 1000)) continue;
+			if (n.leaf) {
+				float t = 0;
+				int slot = Primitive::rayLeaf(vertices.data(), &prims[n.first * C], n.count, o, d, t);
+				int v = prims[(n.first + slot) * C];
+				hitRtn.id = vertexId(v);
+				hitRtn.point = vertices[v];
+				hitRtn.distance = t;
+				return true;
+			}
+			for (int i = n.count - 1; i >= 0; i--) stack[sp++] = n.first + i;
+		}
+		return false;
+	}
+
+	// nearest first: children that the ray enters before the closest hit so
+	// far are pushed farthest first
+	//
+	Ray unit(o, d);
+	float best = FLT_MAX;
+	int bestPrim = -1;
+	pair<Index, float> stack[stackSize];
+	int sp = 0;
+	float t = enterBox(nodes[0].box, unit, 0, best);
+	if (t != FLT_MAX) stack[sp++] = make_pair((Index)0, t);
+	while (sp > 0) {
+		sp--;
+		if (stack[sp].second >= best) continue;
+		const Node & n = nodes[stack[sp].first];
+		context.nodesVisited++;
+		if (n.leaf) {
+			int slot = Primitive::rayLeaf(vertices.data(), &prims[n.first * C], n.count, o, d, best);
+			if (slot >= 0) bestPrim = n.first + slot;
+			continue;
+		}
+		pair<Index, float> hits[8];
+		int numHits = 0;
+		for (int i = 0; i < n.count; i++) {
+			float tc = enterBox(nodes[n.first + i].box, unit, 0, best);
+			if (tc == FLT_MAX) continue;
+			int j = numHits++;
+			while (j > 0 && hits[j - 1].second < tc) {
+				hits[j] = hits[j - 1];
+				j--;
+			}
+			hits[j] = make_pair((Index)(n.first + i), tc);
+		}
+		for (int i = 0; i < numHits; i++) stack[sp++] = hits[i];
+	}
+	if (bestPrim < 0) return false;
+	hitRtn.point = o + d * best;
+	hitRtn.distance = best;
+	int closest = prims[bestPrim * C];
+	for (int c = 1; c < C; c++) {
+		int v = prims[bestPrim * C + c];
+		if (glm::distance2(vertices[v], hitRtn.point) < glm::distance2(vertices[closest], hitRtn.point)) closest = v;
+	}
+	hitRtn.id = vertexId(closest);
+	return true;
+}
+
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+int StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const {
+	idsRtn.clear();
+	context.nodesVisited = 0;
+	if (nodes.empty()) return 0;
+	Index stack[stackSize];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0) {
+		const Node & n = nodes[stack[--sp]];
+		context.nodesVisited++;
+		if (!n.box.overlap(box)) continue;
+		if (!n.leaf) {
+			for (int i = n.count - 1; i >= 0; i--) stack[sp++] = n.first + i;
+			continue;
+		}
+		for (int i = n.first * Primitive::corners; i < (n.first + n.count) * Primitive::corners; i++) {
+			if (box.inside(vertices[prims[i]])) idsRtn.push_back(vertexId(prims[i]));
+		}
+	}
+	sort(idsRtn.begin(), idsRtn.end());
+	idsRtn.erase(std::unique(idsRtn.begin(), idsRtn.end()), idsRtn.end());
+	return idsRtn.size();
+}
+
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+int StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const {
+	context.nodesVisited = 0;
+	if (nodes.empty()) return 0;
+	int count = cellsRtn.size();
+	Index stack[stackSize];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0) {
+		const Node & n = nodes[stack[--sp]];
+		context.nodesVisited++;
+		if (!n.box.overlap(box)) continue;
+		if (n.leaf) cellsRtn.push_back(n.box);
+		else for (int i = n.count - 1; i >= 0; i--) stack[sp++] = n.first + i;
+	}
+	return cellsRtn.size() - count;
+}
+
+//  nearest:  best first over the nodes by box distance, as Octree::nearest
+//
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+int StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::nearest(const glm::vec3 & p, int k, SpatialContext & context,
+	vector<SpatialHit> & hitsRtn) const {
+	hitsRtn.clear();
+	context.nodesVisited = 0;
+	if (k <= 0 || nodes.empty()) return 0;
+	auto farther = [](const pair<float, int> & a, const pair<float, int> & b) { return a.first > b.first; };
+	auto closer = [](const PointHit & a, const PointHit & b) { return a.second < b.second; };
+	vector<PointHit> found;
+	vector<pair<float, int>> heap(1, make_pair(Octree::distance2(nodes[0].box, p), 0));
+	while (!heap.empty()) {
+		pop_heap(heap.begin(), heap.end(), farther);
+		pair<float, int> e = heap.back();
+		heap.pop_back();
+		if (found.size() == k && e.first >= found.front().second) break;
+		context.nodesVisited++;
+		const Node & n = nodes[e.second];
+		if (!n.leaf) {
+			for (int i = 0; i < n.count; i++) {
+				float dist = Octree::distance2(nodes[n.first + i].box, p);
+				if (found.size() < k || dist < found.front().second) {
+					heap.push_back(make_pair(dist, n.first + i));
+					push_heap(heap.begin(), heap.end(), farther);
+				}
+			}
+			continue;
+		}
+		for (int i = n.first * Primitive::corners; i < (n.first + n.count) * Primitive::corners; i++) {
+			int id = vertexId(prims[i]);
+			float dist = glm::distance2(vertices[id], p);
+			if (found.size() == k && dist >= found.front().second) continue;
+			bool seen = false;
+			for (int j = 0; j < found.size() && !seen; j++) seen = found[j].first == id;
+			if (seen) continue;
+			if (found.size() == k) {
+				pop_heap(found.begin(), found.end(), closer);
+				found.pop_back();
+			}
+			found.push_back(make_pair(id, dist));
+			push_heap(found.begin(), found.end(), closer);
+		}
+	}
+	sort_heap(found.begin(), found.end(), closer);
+	hitsRtn.resize(found.size());
+	for (int i = 0; i < found.size(); i++) {
+		hitsRtn[i].id = found[i].first;
+		hitsRtn[i].point = vertices[found[i].first];
+		hitsRtn[i].distance = sqrt(found[i].second);
+	}
+	return hitsRtn.size();
+}
+
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+size_t StaticOctree<Primitive, Index, LeafCapacity, MaxDepth>::memoryUsage() const {
+	return nodes.capacity() * sizeof(Node) + prims.capacity() * sizeof(Index) +
+		vertices.capacity() * sizeof(glm::vec3) + ids.capacity() * sizeof(int);
+}
+
+// the configurations we use (see the typedefs in StaticOctree.h)
+//
+template class StaticOctree<OctreePoints, uint32_t, 1, 20>;
+template class StaticOctree<OctreePoints, uint16_t, 1, 20>;
+template class StaticOctree<OctreeTriangles, uint32_t, 8, 16>;
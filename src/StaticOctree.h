@@ -0,0 +1,140 @@
+#pragma once
+
+#include "ofMain.h"
+#include "SpatialIndex.h"
+
+//  Primitive types for StaticOctree.  A primitive is one or more mesh
+//  vertices ("corners") and goes to the octant holding its reference point:
+//  the vertex itself, or the center of the triangle's bounds.
+//
+//  rayLeaf() is the ray test for one leaf's primitives.  It returns the slot
+//  of the primitive hit (or -1) and updates tRtn, the distance along the unit
+//  direction d.
+//
+struct OctreePoints {
+	static const char * label() { return "points"; }
+	static const int corners = 1;
+	static const bool fitBounds = false;	// nodes keep their octant boxes
+
+	// as Octree: the first leaf crossed by the ray's line, depth first in
+	// octant order, and the leaf point closest to the line
+	//
+	static const bool firstLeafHit = true;
+
+	template <class Index>
+	static int rayLeaf(const glm::vec3 *v, const Index *prims, int count, const glm::vec3 & o, const glm::vec3 & d, float & tRtn) {
+		int best = 0;
+		float bestDist = FLT_MAX;
+		for (int i = 0; i < count; i++) {
+			glm::vec3 w = v[prims[i]] - o;
+			float t = glm::dot(w, d);
+			float dist = glm::dot(w, w) - t * t;
+			if (dist < bestDist) {
+				bestDist = dist;
+				best = i;
+				tRtn = t;
+			}
+		}
+		return best;
+	}
+};
+
+struct OctreeTriangles {
+	static const char * label() { return "triangles"; }
+	static const int corners = 3;
+	static const bool fitBounds = true;		// nodes shrink to their triangles' bounds
+
+	// exact hits: nearest first over the children, keeping the closest hit
+	//
+	static const bool firstLeafHit = false;
+
+	template <class Index>
+	static int rayLeaf(const glm::vec3 *v, const Index *prims, int count, const glm::vec3 & o, const glm::vec3 & d, float & tRtn) {
+		int best = -1;
+		for (int i = 0; i < count; i++) {
+			const Index *c = prims + i * 3;
+			float t;
+			if (intersectTriangle(o, d, v[c[0]], v[c[1]], v[c[2]], t) && t < tRtn) {
+				tRtn = t;
+				best = i;
+			}
+		}
+		return best;
+	}
+};
+
+//  Octree with its configuration fixed at compile time, as a SpatialIndex.
+//
+//  Octree takes its primitive type, leaf size and depth at run time and
+//  keeps a pointer tree of int point lists.  Here they are template
+//  parameters, so the query loops are compiled for one configuration and
+//  carry no switches:
+//
+//    Primitive     OctreePoints or OctreeTriangles
+//    Index         width of the stored vertex indices and node links;
+//                  uint16_t halves them for meshes under 65536 vertices
+//    LeafCapacity  leaves hold up to this many primitives (with Octree's
+//                  split cost test for small nodes when it's above 1)
+//    MaxDepth      levels including the root, as Octree::create(numLevels);
+//                  also sizes the traversal stack
+//
+//  Nodes are a flat array; siblings are contiguous and a leaf's primitives
+//  are a range of one array.  Splits follow Octree::subdivide (same boxes,
+//  points on a split plane go up), so StaticOctree<OctreePoints, uint32_t,
+//  1, 20> has the same leaves and returns the same ray and box results as
+//  the game's octree.
+//
+//  Member definitions are in StaticOctree.cpp and compiled only for the
+//  configurations instantiated at its end (typedefs below).  TerrainStreamer
+//  indexes its tiles with TilePointOctree (TerrainPointOctree for tiles too
+//  big for 16 bits); benchStaticOctree() and benchSpatialIndexes() compare
+//  every configuration against Octree.
+//
+template <class Primitive, class Index, int LeafCapacity, int MaxDepth>
+class StaticOctree : public SpatialIndex {
+public:
+	static_assert(std::is_unsigned<Index>::value, "Index is an unsigned integer type");
+	static_assert(LeafCapacity >= 1, "leaves hold at least one primitive");
+	static_assert(MaxDepth >= 1 && MaxDepth <= 32, "MaxDepth is 1 to 32 levels");
+
+	const char * name() const override;
+	void build(const ofMesh & mesh) override;
+	bool raycast(const Ray & ray, SpatialContext & context, SpatialHit & hitRtn) const override;
+	int overlap(const Box & box, SpatialContext & context, vector<int> & idsRtn) const override;
+	int overlapCells(const Box & box, SpatialContext & context, vector<Box> & cellsRtn) const override;
+	int nearest(const glm::vec3 & p, int k, SpatialContext & context, vector<SpatialHit> & hitsRtn) const override;
+	Box bounds() const override { return nodes.empty() ? Box() : nodes[0].box; }
+	size_t memoryUsage() const override;
+
+	bool empty() const { return nodes.empty(); }
+	int numNodes() const { return nodes.size(); }
+	uint64_t buildMicros = 0;		// time taken by the last build()
+
+private:
+	struct Node {
+		Box box;
+		Index first;		// interior: first child; leaf: first primitive
+		Index count;		// interior: children; leaf: primitives
+		bool leaf;
+	};
+
+	static const int stackSize = 7 * MaxDepth + 1;	// depth first, up to 8 children a level
+	static constexpr float traversalCost = 4;		// Octree's defaults
+	static constexpr float primitiveCost = 1;
+
+	void subdivide(int node, const Box & cell, int first, int count, int level);
+	int vertexId(int v) const { return Primitive::corners == 1 ? v : ids[v]; }
+
+	vector<Node> nodes;
+	vector<Index> prims;			// corners of each primitive, in leaf order
+	vector<glm::vec3> vertices;
+	vector<int> ids;				// triangles: weldUnique id of each mesh vertex
+
+	vector<int> order;				// build scratch: primitive numbers in leaf order
+	vector<glm::vec3> primMin, primMax, centers;
+	vector<uint32_t> corners;
+};
+
+typedef StaticOctree<OctreePoints, uint32_t, 1, 20> TerrainPointOctree;		// the game octree's configuration
+typedef StaticOctree<OctreePoints, uint16_t, 1, 20> TilePointOctree;		// the same for meshes under 65536 vertices
+typedef StaticOctree<OctreeTriangles, uint32_t, 8, 16> TerrainTriangleOctree;	// exact ray hits
@@ -0,0 +1,299 @@
+#include "TerrainAO.h"
+#include <atomic>
+#include <thread>
+
+static const char aoMagic[4] = { 'L', 'M', 'A', 'O' };
+static const uint32_t aoVersion = 2;
+
+static_assert(sizeof(AOSettings) == 32, "ambient occlusion cache header layout changed");
+
+struct AOFileHeader {
+	char magic[4];				// "LMAO"
+	uint32_t version;
+	AOSettings settings;
+	float radius;
+	float tileSize;
+	uint32_t tileCount;
+};
+
+// 64 bit FNV-1a
+//
+static uint64_t hashBytes(const void *data, size_t size, uint64_t h = 14695981039346656037ull) {
+	const uint8_t *p = (const uint8_t *)data;
+	for (size_t i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+static bool sameSettings(const AOSettings & a, const AOSettings & b) {
+	return a.rays == b.rays && a.shadowRays == b.shadowRays && a.maxDistance == b.maxDistance &&
+		a.radius == b.radius && a.lightDir == b.lightDir && a.lightSpread == b.lightSpread;
+}
+
+// van der Corput sequence: the second Hammersley coordinate
+//
+static float radicalInverse(uint32_t bits) {
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+	return bits * 2.3283064365386963e-10f;
+}
+
+// two unit vectors perpendicular to n and each other
+//
+static void basis(const glm::vec3 & n, glm::vec3 & t, glm::vec3 & b) {
+	t = glm::normalize(glm::cross(std::abs(n.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0), n));
+	b = glm::cross(n, t);
+}
+
+static float meanEdgeLength(const ofMesh & mesh) {
+	double sum = 0;
+	size_t n = mesh.getNumIndices() / 3 * 3;
+	for (size_t i = 0; i < n; i += 3) {
+		glm::vec3 a = mesh.getVertex(mesh.getIndex(i));
+		glm::vec3 b = mesh.getVertex(mesh.getIndex(i + 1));
+		glm::vec3 c = mesh.getVertex(mesh.getIndex(i + 2));
+		sum += glm::distance(a, b) + glm::distance(b, c) + glm::distance(c, a);
+	}
+	return n > 0 ? sum / n : 1;
+}
+
+//  makeTiles:  group the vertices into XZ tiles and key each tile by the
+//              positions and normals in the 3 x 3 block around it
+//
+void TerrainAO::makeTiles(const ofMesh & mesh, float tileSize, vector<Tile> & tilesRtn) {
+	tilesRtn.clear();
+	bool normals = mesh.getNumNormals() == mesh.getNumVertices();
+	map<pair<int, int>, int> index;
+	for (int v = 0; v < mesh.getNumVertices(); v++) {
+		const glm::vec3 & p = mesh.getVertex(v);
+		pair<int, int> cell((int)floor(p.x / tileSize), (int)floor(p.z / tileSize));
+		auto it = index.find(cell);
+		if (it == index.end()) {
+			it = index.insert(make_pair(cell, (int)tilesRtn.size())).first;
+			tilesRtn.push_back(Tile());
+			tilesRtn.back().x = cell.first;
+			tilesRtn.back().z = cell.second;
+		}
+		tilesRtn[it->second].vertices.push_back(v);
+	}
+	for (Tile & tile : tilesRtn) {
+		tile.hash = hashBytes(&tile.x, sizeof(tile.x));
+		tile.hash = hashBytes(&tile.z, sizeof(tile.z), tile.hash);
+		for (int v : tile.vertices) {
+			glm::vec3 p = mesh.getVertex(v);
+			tile.hash = hashBytes(&p, sizeof(p), tile.hash);
+			if (!normals) continue;
+			glm::vec3 n = mesh.getNormal(v);
+			tile.hash = hashBytes(&n, sizeof(n), tile.hash);
+		}
+	}
+	for (Tile & tile : tilesRtn) {
+		uint64_t key = hashBytes(&tileSize, sizeof(tileSize));
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				auto it = index.find(make_pair(tile.x + dx, tile.z + dz));
+				uint64_t h = it == index.end() ? 0 : tilesRtn[it->second].hash;
+				key = hashBytes(&h, sizeof(h), key);
+			}
+		}
+		tile.key = key;
+	}
+}
+
+map<pair<int, int>, const TerrainAO::Tile *> TerrainAO::tileIndex() const {
+	map<pair<int, int>, const Tile *> index;
+	for (const Tile & tile : tiles) index[make_pair(tile.x, tile.z)] = &tile;
+	return index;
+}
+
+//  bakeTile:  trace every vertex of the tile; returns the rays cast.  Each
+//             vertex uses the same Hammersley set turned by an angle hashed
+//             from its position, so results don't depend on the thread or
+//             the order tiles are baked in.  Rays start 2 radius out along
+//             the normal, clear of the vertex's own neighbours.
+//
+int TerrainAO::bakeTile(const Octree & octree, Tile & tile, OctreeQueryScratch & scratch) const {
+	const ofMesh & mesh = octree.mesh;
+	const vector<glm::vec3> & normals = mesh.getNormals();
+	glm::vec3 light = glm::normalize(settings.lightDir);
+	glm::vec3 lt, lb;
+	basis(light, lt, lb);
+	int count = 0;
+	tile.ao.resize(tile.vertices.size());
+	tile.light.resize(tile.vertices.size());
+	for (int i = 0; i < tile.vertices.size(); i++) {
+		glm::vec3 p = mesh.getVertex(tile.vertices[i]);
+		glm::vec3 n = glm::normalize(normals[tile.vertices[i]]);
+		glm::vec3 t, b;
+		basis(n, t, b);
+		glm::vec3 origin = p + n * (2 * radius);
+		float turn = (hashBytes(&p, sizeof(p)) >> 40) / 16777216.0f;
+
+		int open = 0;
+		for (int k = 0; k < settings.rays; k++) {
+			float u = (k + 0.5f) / settings.rays;
+			float r = sqrt(u);
+			float phi = TWO_PI * (radicalInverse(k) + turn);
+			glm::vec3 d = t * (r * cos(phi)) + b * (r * sin(phi)) + n * sqrt(1 - u);
+			if (!octree.occluded(origin, d, settings.maxDistance, radius, scratch)) open++;
+		}
+		count += settings.rays;
+
+		int lit = 0;
+		if (glm::dot(n, light) > 0) {
+			for (int k = 0; k < settings.shadowRays; k++) {
+				float r = settings.lightSpread * sqrt((k + 0.5f) / settings.shadowRays);
+				float phi = TWO_PI * (k * 0.618034f + turn);
+				glm::vec3 d = glm::normalize(light + lt * (r * cos(phi)) + lb * (r * sin(phi)));
+				if (!octree.occluded(origin, d, settings.maxDistance, radius, scratch)) lit++;
+			}
+			count += settings.shadowRays;
+		}
+		tile.ao[i] = settings.rays > 0 ? 255 * open / settings.rays : 255;
+		tile.light[i] = settings.shadowRays > 0 ? 255 * lit / settings.shadowRays : 255;
+	}
+	return count;
+}
+
+//  bake:  trace the octree's mesh, which needs normals.  Tiles of "previous"
+//         (a loaded cache) are kept where their key still matches.
+//
+bool TerrainAO::bake(const Octree & octree, const AOSettings & settings, const TerrainAO *previous, int numThreads) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	const ofMesh & mesh = octree.mesh;
+	if (mesh.getNumNormals() != mesh.getNumVertices()) {
+		cout << "Error: ambient occlusion bake needs vertex normals" << endl;
+		return false;
+	}
+
+	// the radius actually used is part of the settings, so a previous cache
+	// is only reused when a full bake would use the same radius
+	//
+	this->settings = settings;
+	radius = settings.radius > 0 ? settings.radius : meanEdgeLength(mesh) / 2;
+	this->settings.radius = radius;
+	if (previous && !sameSettings(previous->settings, this->settings)) previous = NULL;
+	tileSize = settings.maxDistance + 3 * radius;
+	if (previous && previous->tileSize != tileSize) previous = NULL;
+	makeTiles(mesh, tileSize, tiles);
+
+	vector<int> dirty;
+	map<pair<int, int>, const Tile *> old;
+	if (previous) old = previous->tileIndex();
+	for (int i = 0; i < tiles.size(); i++) {
+		auto it = old.find(make_pair(tiles[i].x, tiles[i].z));
+		const Tile *prev = it == old.end() ? NULL : it->second;
+		if (prev && prev->key == tiles[i].key && prev->ao.size() == tiles[i].vertices.size()) {
+			tiles[i].ao = prev->ao;
+			tiles[i].light = prev->light;
+		}
+		else dirty.push_back(i);
+	}
+
+	int n = numThreads > 0 ? numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+	std::atomic<int> next { 0 };
+	std::atomic<uint64_t> rays { 0 };
+	vector<std::thread> threads;
+	for (int i = 0; i < n; i++) {
+		threads.emplace_back([&] {
+			OctreeQueryScratch scratch;
+			int k;
+			while ((k = next++) < dirty.size()) rays += bakeTile(octree, tiles[dirty[k]], scratch);
+		});
+	}
+	for (auto & t : threads) t.join();
+
+	tilesBaked = dirty.size();
+	tilesReused = tiles.size() - dirty.size();
+	raysCast = rays;
+	threadCount = n;
+	seconds = (ofGetElapsedTimeMicros() - start) / 1e6;
+	return true;
+}
+
+bool TerrainAO::save(const string & path) const {
+	AOFileHeader h;
+	memset((void *)&h, 0, sizeof(h));
+	memcpy(h.magic, aoMagic, sizeof(h.magic));
+	h.version = aoVersion;
+	h.settings = settings;
+	h.radius = radius;
+	h.tileSize = tileSize;
+	h.tileCount = tiles.size();
+
+	ofstream out(path, ios::binary);
+	if (!out) return false;
+	out.write((const char *)&h, sizeof(h));
+	for (const Tile & tile : tiles) {
+		uint32_t count = tile.ao.size();
+		out.write((const char *)&tile.x, sizeof(tile.x));
+		out.write((const char *)&tile.z, sizeof(tile.z));
+		out.write((const char *)&tile.key, sizeof(tile.key));
+		out.write((const char *)&count, sizeof(count));
+		out.write((const char *)tile.ao.data(), count);
+		out.write((const char *)tile.light.data(), count);
+	}
+	return (bool)out;
+}
+
+//  load:  tiles come back without their vertex lists; apply() and bake()
+//         match them to a mesh by position and key
+//
+bool TerrainAO::load(const string & path) {
+	tiles.clear();
+	ifstream in(path, ios::binary);
+	AOFileHeader h;
+	if (!in.read((char *)&h, sizeof(h)) || memcmp(h.magic, aoMagic, sizeof(aoMagic)) != 0 || h.version != aoVersion) {
+		return false;
+	}
+	settings = h.settings;
+	radius = h.radius;
+	if (settings.radius <= 0) settings.radius = radius;		// caches from before the radius was stored
+	tileSize = h.tileSize;
+	tiles.resize(h.tileCount);
+	for (Tile & tile : tiles) {
+		uint32_t count = 0;
+		in.read((char *)&tile.x, sizeof(tile.x));
+		in.read((char *)&tile.z, sizeof(tile.z));
+		in.read((char *)&tile.key, sizeof(tile.key));
+		in.read((char *)&count, sizeof(count));
+		if (!in || count > 1u << 28) break;
+		tile.ao.resize(count);
+		tile.light.resize(count);
+		in.read((char *)tile.ao.data(), count);
+		in.read((char *)tile.light.data(), count);
+	}
+	if (!in) {
+		tiles.clear();
+		return false;
+	}
+	return true;
+}
+
+int TerrainAO::apply(ofMesh & mesh, const ofFloatColor & base, float shadow) const {
+	vector<ofFloatColor> & colors = mesh.getColors();
+	colors.assign(mesh.getNumVertices(), base);
+	if (tiles.empty() || tileSize <= 0) return 0;
+
+	vector<Tile> current;
+	makeTiles(mesh, tileSize, current);
+	map<pair<int, int>, const Tile *> baked = tileIndex();
+	int covered = 0;
+	for (const Tile & tile : current) {
+		auto it = baked.find(make_pair(tile.x, tile.z));
+		if (it == baked.end() || it->second->key != tile.key || it->second->ao.size() != tile.vertices.size()) continue;
+		const Tile & b = *it->second;
+		for (int i = 0; i < tile.vertices.size(); i++) {
+			float k = b.ao[i] / 255.0f * (1 - shadow * (1 - b.light[i] / 255.0f));
+			colors[tile.vertices[i]] = ofFloatColor(base.r * k, base.g * k, base.b * k, base.a);
+		}
+		covered += tile.vertices.size();
+	}
+	mesh.enableColors();
+	return covered;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+
+//  Bake settings.  A cache is only reused by bake() or drawn by apply() when
+//  it was baked with the same settings.
+//
+struct AOSettings {
+	int rays = 64;					// cosine weighted hemisphere rays per vertex
+	int shadowRays = 4;				// rays toward the key light, spread over lightSpread
+	float maxDistance = 40;			// occluders farther away than this don't darken or shadow
+	float radius = 0;				// occluder size around each mesh point, 0: half the mean edge
+									// (bake() stores the radius it used)
+	glm::vec3 lightDir = glm::vec3(1, 2, 1) / sqrt(6.0f);	// toward ofApp's key light
+	float lightSpread = 0.05;		// radians
+};
+
+//  Offline per vertex lighting for the terrain: ambient occlusion (the open
+//  fraction of the hemisphere above each vertex) and key light visibility
+//  (shadowed or not), both traced through the octree with its any-hit
+//  occlusion() query out to maxDistance and stored as bytes.
+//
+//  Vertices are grouped into square XZ tiles of side maxDistance + 3 radius
+//  (the ray start is up to 2 radius off the vertex, occluders have radius
+//  size), so every occluder of a vertex lies in its own tile or one of the
+//  eight around it.  Each tile is keyed by a hash of the vertex positions
+//  and normals in that 3 x 3 block; bake() given the previous cache only
+//  traces the tiles whose key changed.  Tiles are handed out to all cores
+//  from a shared counter.
+//
+//  The cache is written with save() by the "--bake-ao" tool and read by the
+//  game, which turns it into vertex colors with apply().  Tiles that no
+//  longer match the mesh are drawn unlit by the cache.
+//
+class TerrainAO {
+public:
+	bool bake(const Octree & octree, const AOSettings & settings, const TerrainAO *previous = NULL, int numThreads = 0);
+	bool save(const string & path) const;
+	bool load(const string & path);
+
+	// vertex colors: base darkened by occlusion and, in shadow, by
+	// "shadow"; returns the number of vertices the cache covered
+	//
+	int apply(ofMesh & mesh, const ofFloatColor & base, float shadow = 0.5) const;
+
+	AOSettings settings;
+	float radius = 0;				// as baked
+	float tileSize = 0;
+
+	// last bake
+	//
+	int tilesBaked = 0, tilesReused = 0;
+	uint64_t raysCast = 0;
+	int threadCount = 0;
+	double seconds = 0;
+
+private:
+	struct Tile {
+		int x = 0, z = 0;
+		uint64_t hash = 0;			// this tile's vertex positions and normals
+		uint64_t key = 0;			// hashes of the 3 x 3 block around it
+		vector<int> vertices;		// mesh indices, ascending
+		vector<uint8_t> ao, light;	// per vertex, 0..255
+	};
+
+	static void makeTiles(const ofMesh & mesh, float tileSize, vector<Tile> & tilesRtn);
+	int bakeTile(const Octree & octree, Tile & tile, OctreeQueryScratch & scratch) const;
+	map<pair<int, int>, const Tile *> tileIndex() const;
+
+	vector<Tile> tiles;
+};
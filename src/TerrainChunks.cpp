@@ -0,0 +1,194 @@
+#include "TerrainChunks.h"
+
+//  Gribb/Hartmann plane extraction: each plane is the last row of the matrix
+//  plus or minus one of the other rows (OpenGL clip space, -w <= z <= w).
+//
+Frustum::Frustum(const glm::mat4 & m) {
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++) row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	planes[0] = row[3] + row[0];	// left
+	planes[1] = row[3] - row[0];	// right
+	planes[2] = row[3] + row[1];	// bottom
+	planes[3] = row[3] - row[1];	// top
+	planes[4] = row[3] + row[2];	// near
+	planes[5] = row[3] - row[2];	// far
+	for (int i = 0; i < 6; i++) {
+		float len = glm::length(glm::vec3(planes[i]));
+		if (len > 0) planes[i] = planes[i] * (1 / len);
+	}
+}
+
+int Frustum::classify(const Box & box) const {
+	Vector3 lo = box.min(), hi = box.max();
+	int result = INSIDE;
+	for (int i = 0; i < 6; i++) {
+		const glm::vec4 & p = planes[i];
+
+		// the box corners farthest along and against the plane normal
+		//
+		float px = p.x >= 0 ? hi.x() : lo.x(), nx = p.x >= 0 ? lo.x() : hi.x();
+		float py = p.y >= 0 ? hi.y() : lo.y(), ny = p.y >= 0 ? lo.y() : hi.y();
+		float pz = p.z >= 0 ? hi.z() : lo.z(), nz = p.z >= 0 ? lo.z() : hi.z();
+		if (p.x * px + p.y * py + p.z * pz + p.w < 0) return OUTSIDE;
+		if (p.x * nx + p.y * ny + p.z * nz + p.w < 0) result = INTERSECTS;
+	}
+	return result;
+}
+
+//  Mirror the octree down to "maxDepth" (or its leaves, if shallower).  Every
+//  node at the bottom becomes a chunk.
+//
+int TerrainChunks::addNode(const TreeNode & node, int depth, int maxDepth, unordered_map<const TreeNode *, int> & chunkOf) {
+	int index = nodes.size();
+	nodes.push_back(ChunkNode());
+	if (depth == maxDepth || node.children.empty()) {
+		nodes[index].chunk = chunks.size();
+		chunkOf[&node] = chunks.size();
+		chunks.push_back(TerrainChunk());
+		return index;
+	}
+	vector<int> kids;
+	for (int i = 0; i < node.children.size(); i++) {
+		kids.push_back(addNode(node.children[i], depth + 1, maxDepth, chunkOf));
+	}
+	nodes[index].firstChild = childList.size();
+	nodes[index].numChildren = kids.size();
+	childList.insert(childList.end(), kids.begin(), kids.end());
+	return index;
+}
+
+void TerrainChunks::build(ofMesh & mesh, const Octree & octree, int depth) {
+	chunks.clear();
+	nodes.clear();
+	childList.clear();
+	unordered_map<const TreeNode *, int> chunkOf;
+	addNode(octree.root, 0, depth, chunkOf);
+
+	// each triangle goes to the chunk whose node holds its centroid, or the
+	// nearest occupied node where the octree has no node for that spot
+	//
+	vector<ofIndexType> & indices = mesh.getIndices();
+	int numTriangles = indices.size() / 3;
+	vector<int> triangleChunk(numTriangles);
+	vector<int> counts(chunks.size(), 0);
+	for (int t = 0; t < numTriangles; t++) {
+		glm::vec3 c = (mesh.getVertex(indices[t * 3]) + mesh.getVertex(indices[t * 3 + 1]) +
+			mesh.getVertex(indices[t * 3 + 2])) / 3.0f;
+		const TreeNode *node = &octree.root;
+		int d = 0;
+		while (d < depth && !node->children.empty()) {
+			const TreeNode *next = &node->children[0];
+			float best = FLT_MAX;
+			for (int i = 0; i < node->children.size(); i++) {
+				float dist = Octree::distance2(node->children[i].box, c);
+				if (dist < best) {
+					best = dist;
+					next = &node->children[i];
+				}
+			}
+			node = next;
+			d++;
+		}
+		triangleChunk[t] = chunkOf[node];
+		counts[triangleChunk[t]]++;
+	}
+
+	// counting sort of the triangles by chunk
+	//
+	int offset = 0;
+	for (int i = 0; i < chunks.size(); i++) {
+		chunks[i].firstIndex = offset;
+		chunks[i].numIndices = counts[i] * 3;
+		offset += counts[i] * 3;
+		counts[i] = chunks[i].firstIndex;
+	}
+	vector<ofIndexType> sorted(indices.size());
+	vector<glm::vec3> lo(chunks.size(), glm::vec3(FLT_MAX)), hi(chunks.size(), glm::vec3(-FLT_MAX));
+	for (int t = 0; t < numTriangles; t++) {
+		int c = triangleChunk[t];
+		for (int k = 0; k < 3; k++) {
+			ofIndexType index = indices[t * 3 + k];
+			sorted[counts[c]++] = index;
+			lo[c] = glm::min(lo[c], mesh.getVertex(index));
+			hi[c] = glm::max(hi[c], mesh.getVertex(index));
+		}
+	}
+	sorted.resize(numTriangles * 3);
+	indices.swap(sorted);
+
+	// chunk bounds cover their triangles, which can stick out of the octree
+	// node.  Children are always added after their parent, so a reverse pass
+	// sees every child before its parent.
+	//
+	for (int i = 0; i < chunks.size(); i++) {
+		chunks[i].bounds = Box(lo[i], hi[i]);
+	}
+	for (int i = nodes.size() - 1; i >= 0; i--) {
+		ChunkNode & n = nodes[i];
+		if (n.chunk != -1) {
+			n.empty = chunks[n.chunk].numIndices == 0;
+			n.bounds = chunks[n.chunk].bounds;
+			continue;
+		}
+		n.bounds = Box(Vector3(FLT_MAX, FLT_MAX, FLT_MAX), Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+		for (int k = 0; k < n.numChildren; k++) {
+			const ChunkNode & child = nodes[childList[n.firstChild + k]];
+			if (child.empty) continue;
+			n.empty = false;
+			n.bounds = n.bounds.merge(child.bounds);
+		}
+	}
+}
+
+void TerrainChunks::addAll(int node, vector<int> & visibleRtn) const {
+	const ChunkNode & n = nodes[node];
+	if (n.empty) return;
+	if (n.chunk != -1) {
+		visibleRtn.push_back(n.chunk);
+		return;
+	}
+	for (int k = 0; k < n.numChildren; k++) addAll(childList[n.firstChild + k], visibleRtn);
+}
+
+void TerrainChunks::cull(int node, const Frustum & frustum, vector<int> & visibleRtn) {
+	const ChunkNode & n = nodes[node];
+	if (n.empty) return;
+	nodesTested++;
+	int side = frustum.classify(n.bounds);
+	if (side == Frustum::OUTSIDE) return;
+	if (side == Frustum::INSIDE || n.chunk != -1) {
+		addAll(node, visibleRtn);
+		return;
+	}
+	for (int k = 0; k < n.numChildren; k++) cull(childList[n.firstChild + k], frustum, visibleRtn);
+}
+
+//  cull:  indices of chunks that may be visible, in index buffer order.
+//
+void TerrainChunks::cull(const Frustum & frustum, vector<int> & visibleRtn) {
+	visibleRtn.clear();
+	nodesTested = 0;
+	if (!nodes.empty()) cull(0, frustum, visibleRtn);
+}
+
+//  ranges:  (first index, index count) runs covering the visible chunks, with
+//           chunks that are adjacent in the index buffer merged.
+//
+void TerrainChunks::ranges(const vector<int> & visible, vector<pair<int, int>> & rangesRtn) const {
+	rangesRtn.clear();
+	for (int i = 0; i < visible.size(); i++) {
+		const TerrainChunk & c = chunks[visible[i]];
+		if (c.numIndices == 0) continue;
+		if (!rangesRtn.empty() && rangesRtn.back().first + rangesRtn.back().second == c.firstIndex) {
+			rangesRtn.back().second += c.numIndices;
+		}
+		else rangesRtn.push_back(make_pair(c.firstIndex, c.numIndices));
+	}
+}
+
+void TerrainChunks::draw(ofVboMesh & mesh, const vector<pair<int, int>> & ranges) const {
+	ofVbo & vbo = mesh.getVbo();
+	for (int i = 0; i < ranges.size(); i++) {
+		vbo.drawElements(GL_TRIANGLES, ranges[i].second, ranges[i].first);
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+
+//  View frustum as six planes (normals pointing inward), extracted from a
+//  view-projection matrix.  Pure math, so culling can run without a window.
+//
+class Frustum {
+public:
+	enum { OUTSIDE = -1, INTERSECTS = 0, INSIDE = 1 };
+
+	Frustum() {}
+	Frustum(const glm::mat4 & viewProjection);
+	int classify(const Box & box) const;
+
+	glm::vec4 planes[6];
+};
+
+// a run of triangles in the terrain index buffer
+//
+struct TerrainChunk {
+	Box bounds;
+	int firstIndex = 0;
+	int numIndices = 0;
+};
+
+//  Terrain cut into chunks along the octree nodes at a chosen depth.
+//
+//  build() reorders the mesh's index buffer so each chunk's triangles are
+//  contiguous and chunks appear in octree (depth first) order, which keeps
+//  chunks that are near each other near each other in the buffer.  cull()
+//  walks a copy of the octree hierarchy with bounds grown to fit the
+//  triangles, dropping whole subtrees outside the frustum and accepting whole
+//  subtrees inside it.  The result is a plain list of visible chunk indices;
+//  ranges() merges it into as few index ranges as possible for drawing.
+//
+class TerrainChunks {
+public:
+	void build(ofMesh & mesh, const Octree & octree, int depth);
+	void cull(const Frustum & frustum, vector<int> & visibleRtn);
+	void ranges(const vector<int> & visible, vector<pair<int, int>> & rangesRtn) const;
+	void draw(ofVboMesh & mesh, const vector<pair<int, int>> & ranges) const;
+
+	vector<TerrainChunk> chunks;
+	int nodesTested = 0;		// hierarchy nodes classified by the last cull()
+
+private:
+	struct ChunkNode {
+		Box bounds;
+		bool empty = true;		// no triangles below this node
+		int firstChild = 0;		// into childList
+		int numChildren = 0;
+		int chunk = -1;			// leaf nodes only
+	};
+
+	int addNode(const TreeNode & node, int depth, int maxDepth, unordered_map<const TreeNode *, int> & chunkOf);
+	void addAll(int node, vector<int> & visibleRtn) const;
+	void cull(int node, const Frustum & frustum, vector<int> & visibleRtn);
+
+	vector<ChunkNode> nodes;
+	vector<int> childList;
+};
@@ -0,0 +1,263 @@
+#include "TerrainStreamer.h"
+#include "Profiler.h"
+
+TerrainStreamer::~TerrainStreamer() {
+	if (worker.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			quit = true;
+		}
+		wake.notify_all();
+		worker.join();
+	}
+}
+
+//  Cut "mesh" into tilesX x tilesZ tiles over its XZ bounds.  Each triangle
+//  goes to the tile holding its centroid, so tiles do not share triangles.
+//  Every tile gets its own compacted mesh and octree, saved next to the
+//  manifest.
+//
+bool TerrainStreamer::buildTiles(const ofMesh & mesh, const string & dir, int tilesX, int tilesZ, int numLevels) {
+	int n = mesh.getNumVertices();
+	int numIndices = mesh.getNumIndices();
+	if (n == 0 || numIndices < 3 || tilesX < 1 || tilesZ < 1) return false;
+	ofDirectory::createDirectory(dir, false, true);
+
+	Box bounds = Octree::meshBounds(mesh);
+	float x0 = bounds.min().x(), z0 = bounds.min().z();
+	float tileW = (bounds.max().x() - x0) / tilesX;
+	float tileD = (bounds.max().z() - z0) / tilesZ;
+
+	// bucket triangles by tile
+	//
+	vector<vector<int>> tileFaces(tilesX * tilesZ);
+	for (int f = 0; f + 2 < numIndices; f += 3) {
+		glm::vec3 c = (mesh.getVertex(mesh.getIndex(f)) + mesh.getVertex(mesh.getIndex(f + 1)) +
+			mesh.getVertex(mesh.getIndex(f + 2))) / 3.0f;
+		int i = glm::clamp((int)((c.x - x0) / tileW), 0, tilesX - 1);
+		int j = glm::clamp((int)((c.z - z0) / tileD), 0, tilesZ - 1);
+		tileFaces[j * tilesX + i].push_back(f);
+	}
+
+	ofstream manifest(dir + "/tiles.txt");
+	if (!manifest) return false;
+	manifest << "tiles " << tilesX << " " << tilesZ << endl;
+
+	bool hasNormals = mesh.getNumNormals() == n;
+	vector<int> remap(n, -1);
+	for (int j = 0; j < tilesZ; j++) {
+		for (int i = 0; i < tilesX; i++) {
+			const vector<int> & faces = tileFaces[j * tilesX + i];
+			if (faces.empty()) continue;
+
+			ofMesh tileMesh;
+			vector<int> used;
+			for (int k = 0; k < faces.size(); k++) {
+				for (int v = 0; v < 3; v++) {
+					int index = mesh.getIndex(faces[k] + v);
+					if (remap[index] == -1) {
+						remap[index] = tileMesh.getNumVertices();
+						used.push_back(index);
+						tileMesh.addVertex(mesh.getVertex(index));
+						if (hasNormals) tileMesh.addNormal(mesh.getNormals()[index]);
+					}
+					tileMesh.addIndex(remap[index]);
+				}
+			}
+			for (int k = 0; k < used.size(); k++) remap[used[k]] = -1;
+
+			Octree octree;
+			octree.create(tileMesh, numLevels);
+			string file = "tile_" + ofToString(i) + "_" + ofToString(j) + ".oct";
+			if (!octree.save(dir + "/" + file)) return false;
+
+			// the draw copy in an ofVboMesh roughly doubles the mesh part
+			//
+			size_t bytes = octree.memoryUsage() + tileMesh.getNumVertices() * sizeof(glm::vec3) * (hasNormals ? 2 : 1) +
+				tileMesh.getNumIndices() * sizeof(ofIndexType);
+			Box b = octree.root.box;
+			manifest << i << " " << j << " " << b.min().x() << " " << b.min().y() << " " << b.min().z() << " "
+				<< b.max().x() << " " << b.max().y() << " " << b.max().z() << " " << bytes << " " << file << endl;
+			cout << "tile " << i << "," << j << ": " << faces.size() << " faces" << endl;
+		}
+	}
+	return (bool)manifest;
+}
+
+//  Read the manifest in "dir" and start the loader thread.
+//
+bool TerrainStreamer::setup(const string & path, size_t memoryBudget) {
+	dir = path;
+	budget = memoryBudget;
+	ifstream manifest(dir + "/tiles.txt");
+	string tag;
+	int tilesX, tilesZ;
+	manifest >> tag >> tilesX >> tilesZ;
+	if (!manifest || tag != "tiles") return false;
+
+	infos.clear();
+	failed.clear();
+	TileInfo info;
+	float x0, y0, z0, x1, y1, z1;
+	while (manifest >> info.i >> info.j >> x0 >> y0 >> z0 >> x1 >> y1 >> z1 >> info.bytes >> info.file) {
+		info.bounds = Box(Vector3(x0, y0, z0), Vector3(x1, y1, z1));
+		infos.push_back(info);
+	}
+	cout << "terrain tiles: " << infos.size() << endl;
+
+	if (!worker.joinable()) worker = std::thread(&TerrainStreamer::loaderThread, this);
+	return !infos.empty();
+}
+
+//  Index a tile's mesh with 16 bit indices when its vertices and nodes fit
+//  them, otherwise with 32 bit ones.
+//
+unique_ptr<SpatialIndex> TerrainStreamer::makeTileIndex(const ofMesh & mesh) {
+	if (mesh.getNumVertices() <= std::numeric_limits<uint16_t>::max()) {
+		unique_ptr<TilePointOctree> small(new TilePointOctree());
+		small->build(mesh);
+		if (!small->empty()) return std::move(small);
+	}
+	unique_ptr<TerrainPointOctree> large(new TerrainPointOctree());
+	large->build(mesh);
+	return std::move(large);
+}
+
+void TerrainStreamer::loaderThread() {
+	while (true) {
+		int id;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return quit || !requests.empty(); });
+			if (quit) return;
+			id = requests.front();
+			requests.pop_front();
+		}
+		auto tile = make_shared<Tile>();
+		tile->id = id;
+		{
+			PROFILE_SCOPE("tile load");
+			Octree octree;
+			if (!octree.load(dir + "/" + infos[id].file)) {
+				cout << "Error: can't load terrain tile " << infos[id].file << endl;
+				tile->failed = true;
+			}
+			else {
+				tile->source = octree.mesh;
+				tile->index = makeTileIndex(tile->source);
+				tile->context = tile->index->newContext();
+			}
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		done.push_back(tile);
+	}
+}
+
+//  Install finished tiles, then choose the tiles to keep: nearest first within
+//  loadRadius, as many as fit in the budget.  Everything else is evicted and
+//  missing wanted tiles are queued for the loader.  Tiles that failed to load
+//  are left out, so they neither use budget nor get requested again.
+//
+void TerrainStreamer::update(const glm::vec3 & focus) {
+	deque<shared_ptr<Tile>> ready;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		ready.swap(done);
+	}
+	for (auto & tile : ready) {
+		pending.erase(tile->id);
+		if (tile->failed) {
+			failed.insert(tile->id);
+			continue;
+		}
+		tile->mesh = tile->source;
+		tile->source.clear();
+		loaded[tile->id] = tile;
+		bytesLoaded += infos[tile->id].bytes;
+	}
+
+	vector<pair<float, int>> nearby;
+	for (int id = 0; id < infos.size(); id++) {
+		const Box & b = infos[id].bounds;
+		float dx = std::max(std::max(b.min().x() - focus.x, 0.0f), focus.x - b.max().x());
+		float dz = std::max(std::max(b.min().z() - focus.z, 0.0f), focus.z - b.max().z());
+		float d = dx * dx + dz * dz;
+		if (d <= loadRadius * loadRadius && failed.count(id) == 0) nearby.push_back(make_pair(d, id));
+	}
+	sort(nearby.begin(), nearby.end());
+
+	set<int> wanted;
+	size_t bytes = 0;
+	for (int k = 0; k < nearby.size(); k++) {
+		int id = nearby[k].second;
+		if (bytes + infos[id].bytes > budget && !wanted.empty()) break;
+		bytes += infos[id].bytes;
+		wanted.insert(id);
+	}
+
+	for (auto it = loaded.begin(); it != loaded.end();) {
+		if (wanted.count(it->first) == 0) {
+			bytesLoaded -= infos[it->first].bytes;
+			it = loaded.erase(it);
+		}
+		else it++;
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (auto it = requests.begin(); it != requests.end();) {
+		if (wanted.count(*it) == 0) {
+			pending.erase(*it);
+			it = requests.erase(it);
+		}
+		else it++;
+	}
+	for (int k = 0; k < nearby.size(); k++) {
+		int id = nearby[k].second;
+		if (wanted.count(id) && loaded.count(id) == 0 && pending.count(id) == 0) {
+			pending.insert(id);
+			requests.push_back(id);
+		}
+	}
+	wake.notify_one();
+}
+
+void TerrainStreamer::draw(bool wireframe) {
+	for (auto & entry : loaded) {
+		if (wireframe) entry.second->mesh.drawWireframe();
+		else entry.second->mesh.drawFaces();
+	}
+}
+
+bool TerrainStreamer::intersect(const Box & box, vector<Box> & boxListRtn) {
+	int count = boxListRtn.size();
+	for (auto & entry : loaded) {
+		if (!infos[entry.first].bounds.overlap(box)) continue;
+		Tile & tile = *entry.second;
+		tile.index->overlapCells(box, *tile.context, boxListRtn);
+	}
+	return boxListRtn.size() > count;
+}
+
+//  Ray against every loaded tile the ray crosses.  Returns the hit point
+//  closest to the ray origin.
+//
+bool TerrainStreamer::intersect(const Ray & ray, glm::vec3 & pointRtn) {
+	bool hit = false;
+	float best = FLT_MAX;
+	glm::vec3 origin = ray.origin;
+	for (auto & entry : loaded) {
+		if (!infos[entry.first].bounds.intersect(ray, -1000, 1000)) continue;
+		Tile & tile = *entry.second;
+		SpatialHit tileHit;
+		if (tile.index->raycast(ray, *tile.context, tileHit)) {
+			glm::vec3 p = tileHit.point;
+			float d = glm::distance2(p, origin);
+			if (d < best) {
+				best = d;
+				pointRtn = p;
+				hit = true;
+			}
+		}
+	}
+	return hit;
+}
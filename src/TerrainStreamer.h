@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "StaticOctree.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+
+//  Terrain split into a grid of tiles, each with its own mesh and octree,
+//  paged in and out around a focus point (the lander).
+//
+//  buildTiles() is the offline step: it cuts a mesh into tiles, builds and
+//  saves an octree per tile and writes a "tiles.txt" manifest.  At run time a
+//  background thread loads tiles and indexes each with a TilePointOctree
+//  (16 bit indices; TerrainPointOctree for tiles too big for them), which
+//  gives the same leaves and ray hits as the saved Octree in less memory.
+//  update() installs tiles on the main thread
+//  and evicts tiles that fell out of range, keeping the estimated memory
+//  under the budget.  Queries visit every loaded tile they touch, so callers
+//  never see tile boundaries.  Tiles that are not loaded yet are treated as
+//  empty, and so are tiles whose file failed to load; those are not
+//  requested again.
+//
+class TerrainStreamer {
+public:
+	~TerrainStreamer();
+
+	static bool buildTiles(const ofMesh & mesh, const string & dir, int tilesX, int tilesZ, int numLevels);
+
+	bool setup(const string & dir, size_t memoryBudget);
+	void update(const glm::vec3 & focus);
+	void draw(bool wireframe);
+
+	bool intersect(const Box & box, vector<Box> & boxListRtn);
+	bool intersect(const Ray & ray, glm::vec3 & pointRtn);
+
+	int numTiles() const { return infos.size(); }
+	int numLoaded() const { return loaded.size(); }
+	size_t memoryLoaded() const { return bytesLoaded; }
+
+	float loadRadius = 200;		// XZ distance from the focus at which tiles are wanted
+
+private:
+	struct TileInfo {
+		int i, j;
+		Box bounds;
+		size_t bytes;		// estimated memory once loaded
+		string file;
+	};
+
+	struct Tile {
+		int id;
+		bool failed = false;	// set by the loader when the file can't be read
+		unique_ptr<SpatialIndex> index;
+		unique_ptr<SpatialContext> context;
+		ofMesh source;			// loaded mesh, moved into "mesh" on the main thread
+		ofVboMesh mesh;
+	};
+
+	static unique_ptr<SpatialIndex> makeTileIndex(const ofMesh & mesh);
+	void loaderThread();
+
+	string dir;
+	vector<TileInfo> infos;
+	map<int, shared_ptr<Tile>> loaded;		// main thread only
+	set<int> pending;						// requested and not installed yet
+	set<int> failed;						// tiles that couldn't be loaded
+	size_t budget = 0;
+	size_t bytesLoaded = 0;
+
+	// shared with the loader thread
+	//
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	deque<int> requests;
+	deque<shared_ptr<Tile>> done;
+	bool quit = false;
+};
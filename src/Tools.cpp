@@ -0,0 +1,165 @@
+#include "Tools.h"
+#include "ofMain.h"
+#include "TerrainStreamer.h"
+#include "ObjLoader.h"
+#include "MeshFile.h"
+#include "TerrainAO.h"
+#include "SimFarm.h"
+
+//  --tile <obj> <outdir> [tilesX tilesZ levels]
+//
+static int tileTool(int argc, char *argv[]) {
+	if (argc < 4) {
+		cout << "usage: --tile <obj> <outdir> [tilesX tilesZ levels]" << endl;
+		return 1;
+	}
+	int tilesX = argc > 4 ? atoi(argv[4]) : 8;
+	int tilesZ = argc > 5 ? atoi(argv[5]) : tilesX;
+	int levels = argc > 6 ? atoi(argv[6]) : 20;
+
+	ofMesh mesh;
+	if (!ObjLoader::load(ofToDataPath(argv[2]), mesh)) {
+		cout << "Error: can't load " << argv[2] << endl;
+		return 1;
+	}
+	ObjLoader::computeNormals(mesh);
+	if (!TerrainStreamer::buildTiles(mesh, ofToDataPath(argv[3]), tilesX, tilesZ, levels)) {
+		cout << "Error: tiling failed" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+//  --convert <obj> <lmsh>
+//
+static int convertTool(int argc, char *argv[]) {
+	if (argc < 4) {
+		cout << "usage: --convert <obj> <lmsh>" << endl;
+		return 1;
+	}
+	ofMesh mesh;
+	if (!ObjLoader::load(ofToDataPath(argv[2]), mesh)) {
+		cout << "Error: can't load " << argv[2] << endl;
+		return 1;
+	}
+	ObjLoader::computeNormals(mesh);
+	if (!MeshFile::write(ofToDataPath(argv[3]), mesh)) {
+		cout << "Error: can't write " << argv[3] << endl;
+		return 1;
+	}
+	cout << argv[3] << ": " << mesh.getNumVertices() << " vertices, " << mesh.getNumIndices() / 3 << " triangles" << endl;
+	return 0;
+}
+
+//  --bake-ao <obj|lmsh> <cache> [rays maxDistance]
+//
+//  Rebakes only the tiles that changed since the cache was last written.
+//
+static int bakeAOTool(int argc, char *argv[]) {
+	if (argc < 4) {
+		cout << "usage: --bake-ao <obj|lmsh> <cache> [rays maxDistance]" << endl;
+		return 1;
+	}
+	string meshPath = ofToDataPath(argv[2]);
+	string cachePath = ofToDataPath(argv[3]);
+	ofMesh mesh;
+	MeshFile meshFile;
+	if (ofFilePath::getFileExt(meshPath) == "lmsh" && meshFile.open(meshPath)) meshFile.copyTo(mesh);
+	else if (!ObjLoader::load(meshPath, mesh)) {
+		cout << "Error: can't load " << argv[2] << endl;
+		return 1;
+	}
+	if (!mesh.hasNormals()) ObjLoader::computeNormals(mesh);
+
+	AOSettings settings;
+	if (argc > 4) settings.rays = atoi(argv[4]);
+	if (argc > 5) settings.maxDistance = atof(argv[5]);
+	Octree octree;
+	octree.create(mesh, 20);
+
+	// an incremental bake keeps the cache's radius; the default (half the
+	// mean edge) would move with every edit and force a full bake
+	//
+	TerrainAO previous, ao;
+	bool incremental = previous.load(cachePath);
+	if (incremental) settings.radius = previous.settings.radius;
+	if (!ao.bake(octree, settings, incremental ? &previous : NULL)) return 1;
+	cout << "ambient occlusion: " << mesh.getNumVertices() << " vertices, " << ao.tilesBaked << " of "
+		<< ao.tilesBaked + ao.tilesReused << " tiles baked (" << ao.tilesReused << " unchanged), " << ao.raysCast
+		<< " rays on " << ao.threadCount << " threads in " << ao.seconds << " s: "
+		<< (ao.seconds > 0 ? ao.raysCast / ao.seconds : 0) << " rays/s" << endl;
+	if (!ao.save(cachePath)) {
+		cout << "Error: can't write " << argv[3] << endl;
+		return 1;
+	}
+	return 0;
+}
+
+//  --farm <obj|lmsh|lmoc> <workers> <rollouts> [image]
+//
+//  A mesh is first turned into a CompactOctree image (next to it, or at
+//  "image"); an ".lmoc" is used as is.  The pointer octree and mesh are
+//  freed before the workers are forked.
+//
+static int farmTool(int argc, char *argv[]) {
+	if (argc < 5) {
+		cout << "usage: --farm <obj|lmsh|lmoc> <workers> <rollouts> [image]" << endl;
+		return 1;
+	}
+	string terrainPath = ofToDataPath(argv[2]);
+	string imagePath = terrainPath;
+	if (ofFilePath::getFileExt(terrainPath) != "lmoc") {
+		imagePath = argc > 5 ? ofToDataPath(argv[5]) : terrainPath.substr(0, terrainPath.rfind('.')) + ".lmoc";
+		ofMesh mesh;
+		MeshFile meshFile;
+		if (ofFilePath::getFileExt(terrainPath) == "lmsh" && meshFile.open(terrainPath)) meshFile.copyTo(mesh);
+		else if (!ObjLoader::load(terrainPath, mesh)) {
+			cout << "Error: can't load " << argv[2] << endl;
+			return 1;
+		}
+		Octree octree;
+		octree.create(mesh, 20);
+		CompactOctree compact;
+		compact.build(octree);
+		cout << "compact octree: " << compact.numNodes() << " nodes, " << compact.numPoints() << " points, "
+			<< compact.memoryUsage() / 1024 << " KB (octree " << octree.memoryUsage() / 1024 << " KB), "
+			<< compact.buildMicros / 1000 << " ms" << endl;
+		if (!compact.save(imagePath)) {
+			cout << "Error: can't write " << imagePath << endl;
+			return 1;
+		}
+	}
+
+	ofMesh landerMesh;
+	if (!ObjLoader::load(ofToDataPath("geo/rocket.obj"), landerMesh)) {
+		cout << "Error: can't load the lander geo/rocket.obj" << endl;
+		return 1;
+	}
+	Box landerBounds = Octree::meshBounds(landerMesh);
+
+	SimFarm farm;
+	if (!farm.setup(imagePath, landerBounds.min(), landerBounds.max(), defaultLandingZones())) return 1;
+	LandingScenario scenario;
+	scenario.start = glm::vec3(0, 50, 0);		// the game's start
+	scenario.rollouts = atoi(argv[4]);
+	LandingEstimate estimate = farm.run(scenario, atoi(argv[3]));
+	if (estimate.rollouts == 0) return 1;
+	LandingEstimator::print(scenario, estimate);
+
+	size_t privateKB = 0;
+	for (size_t kb : farm.workerPrivateKB) privateKB += kb;
+	cout << "  terrain image " << farm.terrain().memoryUsage() / 1024 << " KB shared by " << farm.workerPrivateKB.size()
+		<< " workers, " << (farm.workerPrivateKB.empty() ? 0 : privateKB / farm.workerPrivateKB.size())
+		<< " KB private memory per worker" << endl;
+	return 0;
+}
+
+int runTool(int argc, char *argv[]) {
+	if (argc < 2) return -1;
+	string tool = argv[1];
+	if (tool == "--tile") return tileTool(argc, argv);
+	if (tool == "--convert") return convertTool(argc, argv);
+	if (tool == "--bake-ao") return bakeAOTool(argc, argv);
+	if (tool == "--farm") return farmTool(argc, argv);
+	return -1;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+//  Offline command line tools, run from main() instead of the game when the
+//  first argument names one, e.g.
+//
+//      3D-Lander --tile geo/terrain.obj geo/tiles 8 8 20
+//      3D-Lander --convert geo/terrain.obj geo/terrain.lmsh
+//      3D-Lander --bake-ao geo/terrain.lmsh geo/terrain.ao
+//      3D-Lander --farm geo/terrain.lmsh 8 100000
+//
+//  Returns -1 if argv does not name a tool, otherwise the tool's exit code.
+//
+int runTool(int argc, char *argv[]);
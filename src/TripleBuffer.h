@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+
+//  Single writer, single reader triple buffer.
+//
+//  The writer fills writeBuffer() and publish()es it; the reader calls
+//  acquire() to take the newest published value and reads it through read()
+//  until its next acquire().  Each side owns one of the three slots outright
+//  and they trade slots through one atomic exchange, so neither side ever
+//  waits and the reader never sees a half written value.  The reader skips
+//  values published faster than it acquires them.
+//
+template <class T>
+class TripleBuffer {
+public:
+	T & writeBuffer() { return slots[back]; }
+
+	void publish() {
+		back = middle.exchange(back | fresh, std::memory_order_acq_rel) & indexMask;
+	}
+
+	//  acquire:  take the newest published value if there is one since the
+	//            last acquire.  Returns false (and keeps the old one) if not.
+	//
+	bool acquire() {
+		if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+		return true;
+	}
+
+	const T & read() const { return slots[front]; }
+	T & read() { return slots[front]; }
+
+private:
+	static const int indexMask = 3;
+	static const int fresh = 4;		// set in "middle" when it holds an unread value
+
+	T slots[3];
+	int back = 0;						// writer only
+	int front = 1;						// reader only
+	std::atomic<int> middle { 2 };
+};
@@ -13,6 +13,22 @@
  */
 
 bool Box::intersect(const Ray &r, float t0, float t1) const {
+#ifdef VECTOR3_SSE2
+  // same test on all three slabs at once: pick the near and far corner per
+  // axis from the ray's sign, then the hit interval is the largest near t
+  // and the smallest far t
+  __m128 neg = _mm_cmplt_ps(r.inv_direction.simd(), _mm_setzero_ps());
+  __m128 lo = parameters[0].simd(), hi = parameters[1].simd();
+  __m128 o = r.origin.simd(), inv = r.inv_direction.simd();
+  __m128 tnear = _mm_mul_ps(_mm_sub_ps(_mm_or_ps(_mm_and_ps(neg, hi), _mm_andnot_ps(neg, lo)), o), inv);
+  __m128 tfar = _mm_mul_ps(_mm_sub_ps(_mm_or_ps(_mm_and_ps(neg, lo), _mm_andnot_ps(neg, hi)), o), inv);
+  __m128 tmin = _mm_max_ss(_mm_max_ss(tnear, _mm_shuffle_ps(tnear, tnear, _MM_SHUFFLE(1, 1, 1, 1))),
+                           _mm_shuffle_ps(tnear, tnear, _MM_SHUFFLE(2, 2, 2, 2)));
+  __m128 tmax = _mm_min_ss(_mm_min_ss(tfar, _mm_shuffle_ps(tfar, tfar, _MM_SHUFFLE(1, 1, 1, 1))),
+                           _mm_shuffle_ps(tfar, tfar, _MM_SHUFFLE(2, 2, 2, 2)));
+  float tn = _mm_cvtss_f32(tmin), tf = _mm_cvtss_f32(tmax);
+  return (tn <= tf) && (tn < t1) && (tf > t0);
+#else
   float tmin, tmax, tymin, tymax, tzmin, tzmax;
 
   tmin = (parameters[r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
@@ -34,4 +50,5 @@ bool Box::intersect(const Ray &r, float t0, float t1) const {
   if (tzmax < tmax)
     tmax = tzmax;
   return ( (tmin < t1) && (tmax > t0) );
+#endif
 }
@@ -29,14 +29,19 @@ class Box {
     // corners
     Vector3 parameters[2];
 
-	Vector3 min() { return parameters[0]; }
-	Vector3 max() { return parameters[1]; }
-	const bool inside(const Vector3 &p) {
+	Vector3 min() const { return parameters[0]; }
+	Vector3 max() const { return parameters[1]; }
+	bool inside(const Vector3 &p) const {
+#ifdef VECTOR3_SSE2
+		__m128 in = _mm_and_ps(_mm_cmpge_ps(p.simd(), parameters[0].simd()), _mm_cmple_ps(p.simd(), parameters[1].simd()));
+		return (_mm_movemask_ps(in) & 7) == 7;
+#else
 		return ((p.x() >= parameters[0].x() && p.x() <= parameters[1].x()) &&
 		     	(p.y() >= parameters[0].y() && p.y() <= parameters[1].y()) &&
 			    (p.z() >= parameters[0].z() && p.z() <= parameters[1].z()));
+#endif
 	}
-	const bool inside(Vector3 *points, int size) {
+	bool inside(Vector3 *points, int size) const {
 		bool allInside = true;
 		for (int i = 0; i < size; i++) {
 			if (!inside(points[i])) allInside = false;
@@ -47,13 +52,34 @@ class Box {
 
 	// implement for Homework Project
 	//
-	 bool overlap(Box &box) {
+	 bool overlap(const Box &box) const {
+#ifdef VECTOR3_SSE2
+		__m128 lo = _mm_cmple_ps(parameters[0].simd(), box.parameters[1].simd());
+		__m128 hi = _mm_cmpge_ps(parameters[1].simd(), box.parameters[0].simd());
+		return (_mm_movemask_ps(_mm_and_ps(lo, hi)) & 7) == 7;
+#else
 		 return (min().x() <= box.max().x() && max().x() >= box.min().x()) &&
 				(min().y() <= box.max().y() && max().y() >= box.min().y()) &&
 				(min().z() <= box.max().z() && max().z() >= box.min().z());
+#endif
 	}
 
-	Vector3 center() {
+	// true if box lies strictly inside this one (no shared faces), so
+	// nothing outside this box can overlap it
+	//
+	bool contains(const Box &box) const {
+		return (box.min().x() > min().x() && box.max().x() < max().x()) &&
+			   (box.min().y() > min().y() && box.max().y() < max().y()) &&
+			   (box.min().z() > min().z() && box.max().z() < max().z());
+	}
+
+	// smallest box holding both
+	//
+	Box merge(const Box &box) const {
+		return Box(Vector3::min(parameters[0], box.parameters[0]), Vector3::max(parameters[1], box.parameters[1]));
+	}
+
+	Vector3 center() const {
 		return ((max() - min()) / 2 + min());
 	}
 };
@@ -1,13 +1,45 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "Tools.h"
 
 //========================================================================
-int main( ){
-	ofSetupOpenGL(1280, 1024,OF_WINDOW);			// <-------- setup the GL context
+int main(int argc, char *argv[]){
+
+	// offline tools (terrain tiling etc) run instead of the game
+	//
+	int status = runTool(argc, argv);
+	if (status != -1) return status;
+
+	//  --record <file>  record keyboard input and RNG seed, written on exit
+	//  --replay <file>  play a recording back at full speed, then quit
+	//  --hidden         no visible window (for unattended replays)
+	//  --estimate <n>   fly n autopilot landings, print the outcome, then quit
+	//  --procedural-zones  landing zones on the flattest terrain instead of the fixed ones
+	//  --bvh            altitude ray and picking against the terrain triangles (BVH) instead of the octree
+	//
+	ofApp *app = new ofApp();
+	bool hidden = false;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--record" && i + 1 < argc) app->recordPath = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc) app->replayPath = argv[++i];
+		else if (arg == "--estimate" && i + 1 < argc) app->estimateRollouts = atoi(argv[++i]);
+		else if (arg == "--procedural-zones") app->bProceduralZones = true;
+		else if (arg == "--bvh") app->bBvhRays = true;
+		else if (arg == "--hidden") hidden = true;
+	}
+
+	if (hidden) {
+		ofGLFWWindowSettings settings;
+		settings.setSize(1280, 1024);
+		settings.visible = false;
+		ofCreateWindow(settings);
+	}
+	else ofSetupOpenGL(1280, 1024,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofRunApp(app);
 
 }
@@ -1,36 +1,28 @@
 #include "ofApp.h"
 #include "Util.h"
+#include "Benchmark.h"
+#include "ObjLoader.h"
+#include "MeshFile.h"
 #include <glm/gtx/intersect.hpp>
 
-static void explode(glm::vec3 pos, Emitter* em) {
-	for (int x = 0; x < 300; x++) {
-		Particle child;
-		child.birthtime = ofGetElapsedTimeMillis();
-		child.lifespan = 1000;
-		child.pos = pos;
-		child.velocity = glm::vec3(RandomFloat(-3000, 3000), RandomFloat(-3000, 3000), RandomFloat(-3000, 3000));
-		child.scale = glm::vec3(0.15, 0.15, 0.15);
-		em->sys->add(child);
-	}
-}
-
-static void thrust(glm::vec3 pos, Emitter* em) {
-	for (int x = 0; x < 10; x++) {
-		Particle child;
-		child.radius = 1;
-		child.birthtime = ofGetElapsedTimeMillis();
-		child.lifespan = 50;
-		child.pos = pos;
-		child.velocity = glm::vec3(RandomFloat(-30, 30), RandomFloat(-300, 0), RandomFloat(-30, 30));
-		child.scale = glm::vec3(0.1, 0.1, 0.1);
-		em->sys->add(child);
-	}
-}
-
 //--------------------------------------------------------------
 // setup scene, lighting, state and load geometry
 //
 void ofApp::setup(){
+
+	// a replay reuses the recorded seed and tick rate; a recording picks a
+	// seed and runs the simulation at a fixed tick rate
+	//
+	uint32_t seed = (uint32_t)time(NULL);
+	if (!replayPath.empty()) {
+		if (input.startReplay(replayPath)) seed = input.seed;
+		else cout << "Error: can't read input recording " << replayPath << endl;
+	}
+	else if (!recordPath.empty()) input.startRecording(seed, 60);
+	ofSeedRandom(seed);
+	srand(seed);
+	sim.seed(seed);
+
 	bWireframe = false;
 	bLanderLoaded = false;
 	bTerrainSelected = true;
@@ -42,6 +34,10 @@ void ofApp::setup(){
 	ofEnableSmoothing();
 	ofEnableDepthTest();
 	ofSetFrameRate(60);
+	if (input.mode == InputRecorder::REPLAYING) {
+		ofSetVerticalSync(false);		// replays run as fast as they can
+		ofSetFrameRate(0);
+	}
 
 	bumpS.load("sounds/bump.wav");
 	crashS.load("sounds/crash.wav");
@@ -52,10 +48,18 @@ void ofApp::setup(){
 
 	gui.setup();
     gui.add(altitudeLabel.setup("Altitude AGL", "0.00"));
-    gui.add(fuelLabel.setup("Fuel (s)", ofToString((int)fuel)));
+    gui.add(fuelLabel.setup("Fuel (s)", "120"));
+    gui.add(clearanceLabel.setup("Clearance", "0.00"));
+    gui.add(siteLabel.setup("Landing site", "OFF"));
 
-	mars.loadModel("geo/terrain.obj");
-	mars.setScaleNormalization(false);
+	// terrain split into tiles with "--tile" is streamed in around the
+	// lander instead of loading the whole map
+	//
+	bStreamTerrain = ofFile::doesFileExist("geo/tiles/tiles.txt") &&
+		terrainStreamer.setup(ofToDataPath("geo/tiles"), terrainMemoryBudget);
+	if (!bStreamTerrain) loadTerrainAsync();
+	terrainMaterial.setDiffuseColor(terrainColor);
+	terrainMaterial.setAmbientColor(ofFloatColor(0.3, 0.2, 0.15));
     
     stars.reserve(200);
       for(int i = 0; i < 200; ++i){
@@ -65,211 +69,226 @@ void ofApp::setup(){
     lander.loadModel("geo/rocket.obj");
     lander.setScaleNormalization(false);
     lander.setPosition(0,50, 0);
-	shipVelocity = 0;
-	shipAcceleration = -(1.625 / std::pow(ofGetFrameRate(), 2));
-	shipVelocityX = 0;
-	shipAccelerationX = (1 / std::pow(ofGetFrameRate(), 2));
-	shipVelocityZ = 0;
-	shipAccelerationZ = (1 / std::pow(ofGetFrameRate(), 2));
     bLanderLoaded = true;
     
-    //mountains
-    landingZones.push_back(glm::vec3(50, 0.2, -179));
-    //behind mountains
-    landingZones.push_back(glm::vec3(-180, 0.2, 154));
-    //middle
-    landingZones.push_back(glm::vec3(0, 0.2, 20));
+    landingZones = defaultLandingZones();
     
-	shooter = new AgentEmitter();
-	shooter->emitterVelocity = shipVelocity;
-	shooter->emitterAcceleration = shipAcceleration;
-	shooter->drawable = true;
+}
+
+//--------------------------------------------------------------
+// load the terrain mesh and build its octree, height field and draw chunks
+// on background threads, so the window is up while they run.  The octree
+// and height field only read the mesh and are built at the same time.
+//
+void ofApp::loadTerrainAsync() {
+	int load = terrainLoader.add("loading terrain", 3, [this] {
+
+		// prefer the binary mesh written by "--convert", fall back to the OBJ
+		//
+		MeshFile terrainFile;
+		if (terrainFile.open(ofToDataPath("geo/terrain.lmsh"))) {
+			terrainFile.copyTo(loadingMesh);
+		}
+		else if (!ObjLoader::load(ofToDataPath("geo/terrain.obj"), loadingMesh)) {
+			cout << "Error: can't load terrain geo/terrain.obj" << endl;
+			return false;
+		}
+		if (!loadingMesh.hasNormals()) ObjLoader::computeNormals(loadingMesh);
+
+		// baked occlusion and shadow ("--bake-ao") as vertex colors
+		//
+		TerrainAO ao;
+		if (ao.load(ofToDataPath("geo/terrain.ao"))) {
+			int covered = ao.apply(loadingMesh, terrainColor);
+			cout << "terrain lighting: " << covered << " of " << loadingMesh.getNumVertices() << " vertices from the cache" << endl;
+		}
+		return true;
+	});
 
-	shooter->pos = lander.getPosition();
+	//  Single point leaves (the default leafSize): the contact test in the
+	//  simulation counts overlapping leaf boxes and its threshold is tuned
+	//  for them.
+	//
+	int build = terrainLoader.add("building octree", 4, [this] {
+		terrainIndex.build(loadingMesh);
+		cout << "octree: " << octree.mesh.getNumVertices() << " vertices, " << octree.weldUnique.size() << " unique points, "
+			<< Octree::countNodes(octree.root) << " nodes, " << octree.buildMicros / 1000 << " ms" << endl;
+		return true;
+	}, { load });
+
+	// altitude and ground clearance come from the height grid
+	//
+	int bake = terrainLoader.add("baking height field", 1, [this] {
+		heightField.bake(loadingMesh, heightFieldResolution);
+		cout << "heightfield: " << heightField.width << " x " << heightField.depth << " samples, cell "
+			<< heightField.cellSize << endl;
+		return true;
+	}, { load });
+
+	// slope and flatness of the height grid, for landing site queries; sites
+	// are squares as wide as a landing zone
+	//
+	terrainLoader.add("indexing landing sites", 1, [this] {
+		landingMap.build(heightField, landingZoneSize);
+		cout << "landing map: " << landingMap.width << " x " << landingMap.depth << " cells, " << landingMap.numSites
+			<< " sites of " << landingMap.siteSize() << " x " << landingMap.siteSize() << " cells, "
+			<< landingMap.buildMicros / 1000 << " ms" << endl;
+		return true;
+	}, { bake });
+
+	// exact triangle hits for the altitude ray and picking, when asked for
+	//
+	vector<int> readers = { build, bake };
+	if (bBvhRays) {
+		readers.push_back(terrainLoader.add("building bvh", 2, [this] {
+			terrainBvh.build(loadingMesh);
+			cout << "bvh: " << terrainBvh.numTriangles() << " triangles, " << terrainBvh.numNodes() << " nodes, depth "
+				<< terrainBvh.maxDepth << ", " << terrainBvh.buildMicros / 1000 << " ms" << endl;
+			return true;
+		}, { load }));
+	}
+
+	// reorders the terrain's index buffer into per node chunks for culling,
+	// so it waits for the jobs still reading it
+	//
+	terrainLoader.add("chunking terrain", 1, [this] {
+		terrainChunks.build(loadingMesh, octree, terrainChunkDepth);
+		cout << "terrain chunks: " << terrainChunks.chunks.size() << " at depth " << terrainChunkDepth << endl;
+		return true;
+	}, readers);
+	terrainLoader.start();
+}
 
-	shooter->start();
+//--------------------------------------------------------------
+// once loading is done (main thread): hand the mesh to the renderer and
+// start the simulation, all in one frame
+//
+void ofApp::publishTerrain() {
+	terrainLoader.wait();
+	bool ok = !bStreamTerrain && !terrainLoader.failed();
+	if (ok) terrainMesh = loadingMesh;
+	loadingMesh.clear();
+
+	// replace the hand placed landing zones with the flattest sites that are
+	// well apart, when there are enough of them
+	//
+	if (ok && bProceduralZones) {
+		vector<glm::vec3> sites;
+		if (landingMap.pickSites(landingZones.size(), landingZoneSize * 8, sites) == landingZones.size()) landingZones = sites;
+		else cout << "not enough flat landing sites, keeping the default landing zones" << endl;
+	}
 
-	//  Create Octree for testing.
+	// the simulation gets its own thread, except for runs that must repeat
+	// exactly (recording or replaying input) and streamed terrain, which is
+	// stepped once per frame from update()
 	//
-	octree.create(mars.getMesh(0), 20);
+	sim.setup(ok ? &terrainIndex : NULL, bStreamTerrain ? &terrainStreamer : NULL, &heightField,
+		lander.getSceneMin(), lander.getSceneMax(), lander.getPosition(), landingZones, landingZoneSize,
+		input.mode == InputRecorder::LIVE ? 60 : input.tickRate);
+	if (ok) sim.setLandingMap(&landingMap);
+	if (ok && bBvhRays) sim.setRayTerrain(&terrainBvh);
+	if (input.mode == InputRecorder::LIVE) sim.start();
+	landerContext = terrainIndex.newContext();
+	pickContext = rayTerrain().newContext();
+	if (ok) estimator.setup(&terrainIndex, &heightField, lander.getSceneMin(), lander.getSceneMax(), landingZones);
+	bTerrainReady = true;
+
+	if (estimateRollouts > 0) {
+		runEstimate(estimateRollouts);
+		ofExit(0);
+	}
 }
  
 //--------------------------------------------------------------
 // incrementally update scene (animation)
 //
 void ofApp::update() {
-    glm::vec3 landerPos = lander.getPosition();
-    ofVec3f min = lander.getSceneMin() + landerPos;
-    ofVec3f max = lander.getSceneMax() + landerPos;
-	Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-	vector<Box> collisions;
-	octree.intersect(bounds, octree.root, collisions);
-    
-	shooter->update();
-    
-	if (landingStarted) {
-		if (collisions.size() < 10) {
-			
-            bool anyKeyPressed = false;
-            
-			if (keymap[32] && fuel > 0.0f) {
-				shipVelocity += (10.0 / std::pow(ofGetFrameRate(), 2));
-				thrust(landerPos, shooter);
-				thrustS.setLoop(true);
-				if (!thrustS.isPlaying())
-					thrustS.play();
-				fuelTimer += 1.0f / ofGetFrameRate();
-				if (fuelTimer >= 1.0f) {
-					fuelTimer -= 1.0f;
-					fuel = std::max(0.0f, fuel - 1.0f);
-					fuelLabel = ofToString((int)fuel);
-				}
-                bool anyKeyPressed = true;
-			}
-            
-			if (keymap[OF_KEY_LEFT]) {
-				shipVelocityX -= shipAccelerationX;
-                bool anyKeyPressed = true;
-			}
-			if (keymap[OF_KEY_RIGHT]) {
-				shipVelocityX += shipAccelerationX;
-                bool anyKeyPressed = true;
-            }
-			if (keymap[OF_KEY_UP]) {
-				shipVelocityZ -= shipAccelerationZ;
-                bool anyKeyPressed = true;
-            }
-			if (keymap[OF_KEY_DOWN]) {
-				shipVelocityZ += shipAccelerationZ;
-                bool anyKeyPressed = true;
-            }
-			
-            if (anyKeyPressed) {
-                thrustS.setLoop(true);
-                if (!thrustS.isPlaying()) {
-                    thrustS.play();
-                }
-            }
-            else {
-                thrustS.setLoop(false);
-            }
-            
-			shipVelocity += shipAcceleration;
-			
-            float turbulenceX = ofRandom(-0.05f, 0.05f);
-            float turbulenceZ = ofRandom(-0.05f, 0.05f);
-            lander.setPosition(
-                landerPos.x + shipVelocityX + turbulenceX,
-                landerPos.y + shipVelocity,
-                landerPos.z + shipVelocityZ + turbulenceZ
-            );
-
-            shooter->pos = landerPos;
+	PROFILE_FRAME();
+
+	// gameplay (and input replay) starts when the terrain is ready
+	//
+	if (!bTerrainReady) {
+		if (!terrainLoader.finished()) return;
+		publishTerrain();
+	}
+
+	// recorded key events are applied before the tick they arrived in
+	//
+	if (input.mode != InputRecorder::LIVE) {
+		if (!input.beginTick(tickEvents)) {
+			finishReplay();
+			return;
 		}
-		else {
-            if (std::abs(shipVelocity) > 0.08) {
-				explode(landerPos, shooter);
-				crashS.play();
-                explosionVelocity = glm::vec3(
-                        ofRandom(-150, 150),
-                        ofRandom(200, 300),
-                        ofRandom(-150, 150)
-                    );
-                explosionActive = true;
-                landingStarted = false;
-                gameOver = true;
-                showGameOverText = true;
-			}
+		bInjectingInput = true;
+		for (const InputEvent & e : tickEvents) {
+			if (e.pressed) keyPressed(e.key);
+			else keyReleased(e.key);
 		}
+		bInjectingInput = false;
 	}
-    
-    if (explosionActive) {
-        explosionVelocity += glm::vec3(0, -0.2, 0);
-        landerPos += explosionVelocity * ofGetLastFrameTime();
-        lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
-        lander.setRotation(0, ofRandom(-5, 5), 0, 1, 0);
-    }
 
-    if (bResolveCollision) {
-        landerPos += collisionDirection * collisionSpeed;
-        lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
-       
-        
-        if (collisions.size() < 10) {
-            bResolveCollision = false;
-        }
-    }
-    else if (!bResolveCollision && collisions.size() >= 10) {
-        float impactForce = std::abs(shipVelocity);
-        
-        if (impactForce <= 0.015f) {
-            for (auto& zone : landingZones) {
-                if (glm::distance(landerPos, zone) < landingZoneSize) {
-                    gameWin = true;
-                    landingStarted = false;
-                    return;
-                }
-            }
-        }
-        collisionDirection = glm::vec3(0, impactForce * 1.2f, 0);
-		bumpS.play();
-        bResolveCollision = true;
-        shipVelocity = 0;
-        shipVelocityX = 0;
-        shipVelocityZ = 0;
-    }
-    
-    if (bShowTelemetry) {
-        Ray downRay(Vector3(landerPos.x, landerPos.y, landerPos.z), Vector3(0, -1, 0));
-        TreeNode hitNode;
-        float altitude = 0;
-        if (octree.intersect(downRay, octree.root, hitNode)) {
-            auto v = octree.mesh.getVertex(hitNode.points[0]);
-            altitude = landerPos.y - v.y;
-        }
-        altitudeLabel = ofToString(altitude, 2);
-    } else {
-        altitudeLabel = "OFF";
-    }
-        
-    switch (currentCam) {
-        case FREE_CAM:
-            break;
+	sim.setCameraMode(currentCam);
+	sim.setTelemetry(bShowTelemetry);
+	sim.step();
+	sim.acquire();
+	applySnapshot(sim.snapshot());
+}
 
-        case TRACK_CAM:
-            cam.disableMouseInput();
-            cam.setPosition(landerPos + glm::vec3(0, 5, 10));
-            cam.lookAt(landerPos);
-            break;
+//--------------------------------------------------------------
+// show the latest simulation tick: lander, sounds, readouts and the
+// follow cameras
+//
+void ofApp::applySnapshot(const SimSnapshot & state) {
+	if (input.mode == InputRecorder::REPLAYING && input.tick > 1) {
+		replayStats.frames++;
+		replayStats.frameSeconds += ofGetLastFrameTime();
+		replayStats.worstFrame = std::max(replayStats.worstFrame, ofGetLastFrameTime());
+		replayStats.nodesVisited += state.nodesVisited;
+	}
 
-        case BOTTOM_CAM: {
-            cam.disableMouseInput();
-            bDisplayOctree = false;
+	glm::vec3 landerPos = state.landerPos;
+	if (!bInDrag) lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
+	lander.setRotation(0, state.landerRotation, 0, 1, 0);
 
-            glm::vec3 min = glm::vec3(lander.getSceneMin());
-            glm::vec3 rocketBottom = landerPos + glm::vec3(0, min.y, 0);
-            glm::vec3 cameraPos = rocketBottom + glm::vec3(0, 0.5f, 0);
-            glm::vec3 lookAtPos = rocketBottom + glm::vec3(0, -10.0f, 0);
+	thrustS.setLoop(state.thrusting);
+	if (state.thrusting && !thrustS.isPlaying()) thrustS.play();
+	if (state.crashes > lastCrashes) crashS.play();
+	if (state.bumps > lastBumps) bumpS.play();
+	lastCrashes = state.crashes;
+	lastBumps = state.bumps;
 
-            cam.setPosition(cameraPos);
-            cam.lookAt(lookAtPos);
-            break;
-        }
+	if ((int)state.fuel != lastFuel) {
+		lastFuel = state.fuel;
+		fuelLabel = ofToString(lastFuel);
+	}
+	if (bShowTelemetry) {
+		altitudeLabel = ofToString(state.altitude, 2);
+		clearanceLabel = ofToString(state.clearance, 2);
+		if (state.landable) siteLabel = "flat";
+		else if (state.siteDistance >= 0) siteLabel = ofToString(state.siteDistance, 1) + " away";
+		else siteLabel = "none";
+	}
+	else {
+		altitudeLabel = "OFF";
+		clearanceLabel = "OFF";
+		siteLabel = "OFF";
+	}
 
-        case TOP_CAM:
-            cam.disableMouseInput();
-            cam.setPosition(landerPos + glm::vec3(0, 25, 0));
-            cam.lookAt(landerPos);
-            break;
-    }
-    lander.setRotation(0, landerRotation, 0, 1, 0);
-    
-    if(bShipLightOn) {
-        shipLight.setPosition(landerPos.x, landerPos.y - 2, landerPos.z);
-        shipLight.enable();
-    } else {
-        shipLight.disable();
-    }
+	if (currentCam != FREE_CAM && state.followCamera) {
+		PROFILE_SCOPE("camera");
+		cam.disableMouseInput();
+		if (currentCam == BOTTOM_CAM) bDisplayOctree = false;
+		cam.setPosition(state.cameraEye);
+		cam.lookAt(state.cameraTarget);
+	}
+
+	if (bShipLightOn) {
+		shipLight.setPosition(landerPos.x, landerPos.y - 2, landerPos.z);
+		shipLight.enable();
+	}
+	else {
+		shipLight.disable();
+	}
 }
 
 //--------------------------------------------------------------
@@ -278,8 +297,11 @@ void ofApp::draw() {
     
     ofDisableDepthTest();
     glDepthMask(false);
-    drawStarfield();
-    gui.draw();
+    {
+        PROFILE_SCOPE("draw background");
+        drawStarfield();
+        gui.draw();
+    }
     glDepthMask(true);
     ofEnableDepthTest();
     
@@ -296,7 +318,8 @@ void ofApp::draw() {
 	if (bWireframe) {                    // wireframe mode  (include axis)
 		ofDisableLighting();
 		ofSetColor(ofColor::slateGray);
-		mars.drawWireframe();
+		if (bStreamTerrain) terrainStreamer.draw(true);
+		else terrainMesh.drawWireframe();
 		if (bLanderLoaded) {
 			lander.drawWireframe();
 			if (!bTerrainSelected) drawAxis(lander.getPosition());
@@ -305,44 +328,78 @@ void ofApp::draw() {
 	}
 	else {
 		ofEnableLighting();              // shaded mode
-		mars.drawFaces();
+		{
+			PROFILE_SCOPE("draw terrain");
+			terrainMaterial.begin();
+			if (bStreamTerrain) terrainStreamer.draw(false);
+			else if (bCullTerrain && bTerrainReady) {
+				terrainChunks.cull(Frustum(cam.getModelViewProjectionMatrix()), visibleChunks);
+				terrainChunks.ranges(visibleChunks, visibleRanges);
+				terrainChunks.draw(terrainMesh, visibleRanges);
+			}
+			else terrainMesh.drawFaces();
+			terrainMaterial.end();
+		}
 		ofMesh mesh;
 		if (bLanderLoaded) {
-			lander.drawFaces();
-			if (!bTerrainSelected) drawAxis(lander.getPosition());
-			if (bDisplayBBoxes) {
-				ofNoFill();
-				ofSetColor(ofColor::white);
-				for (int i = 0; i < lander.getNumMeshes(); i++) {
-					ofPushMatrix();
-					ofMultMatrix(lander.getModelMatrix());
-					ofRotate(-90, 1, 0, 0);
-					Octree::drawBox(bboxList[i]);
-					ofPopMatrix();
+			{
+				PROFILE_SCOPE("draw lander");
+				lander.drawFaces();
+				if (!bTerrainSelected) drawAxis(lander.getPosition());
+				if (bDisplayBBoxes) {
+					ofNoFill();
+					ofSetColor(ofColor::white);
+					for (int i = 0; i < lander.getNumMeshes(); i++) {
+						ofPushMatrix();
+						ofMultMatrix(lander.getModelMatrix());
+						ofRotate(-90, 1, 0, 0);
+						Octree::drawBox(bboxList[i]);
+						ofPopMatrix();
+					}
 				}
 			}
-			shooter->draw();
+			PROFILE_SCOPE("draw particles");
+			for (Particle & p : sim.snapshot().particles) p.draw();
 
         }
 	}
 	if (bTerrainSelected) drawAxis(ofVec3f(0, 0, 0));
 
-	// recursively draw octree
+	// octree debug view, one batched line mesh per level
 	//
 	ofDisableLighting();
+	if (!bStreamTerrain && bTerrainReady) {
+		PROFILE_SCOPE("draw octree");
+		if (bDisplayOctree) octree.draw(octreeDisplayLevel, 1);
+		if (bDisplayLeafNodes) {
+			ofSetColor(ofColor::white);
+			octree.drawLeafNodes();
+		}
+	}
 	
 	ofPopMatrix();
 	cam.end();
     
-    if (showGameOverText) {
+    if (sim.snapshot().gameOver) {
         ofSetColor(ofColor::red);
         ofDrawBitmapString("YOU LOSE!\nPress R to Restart", ofGetWidth()/2 - 60, ofGetHeight()/2);
     }
     
-    if (gameWin) {
+    if (sim.snapshot().gameWin) {
         ofSetColor(ofColor::green);
         ofDrawBitmapString("YOU WIN!\nPress R to Restart", ofGetWidth()/2 - 60, ofGetHeight()/2);
     }
+
+    if (!bTerrainReady) {
+        ofSetColor(ofColor::white);
+        string status = terrainLoader.status();
+        ofDrawBitmapString("Loading " + ofToString((int)(terrainLoader.progress() * 100)) + "%" +
+            (status.empty() ? "" : "  (" + status + ")"), ofGetWidth()/2 - 120, ofGetHeight()/2);
+    }
+
+#ifdef LANDER_PROFILE
+    if (bShowProfiler) Profiler::get().drawOverlay(20, ofGetHeight() - 140);
+#endif
 }
 
 // 
@@ -373,13 +430,11 @@ void ofApp::drawAxis(ofVec3f location) {
 
 
 void ofApp::keyPressed(int key) {
+	if (input.mode == InputRecorder::REPLAYING && !bInjectingInput) return;
+	input.record(key, true);
+	sim.key(key, true);
+
 	switch (key) {
-    case 'a':
-        landerRotation -= rotationSpeed;
-        break;
-    case 'd':
-        landerRotation += rotationSpeed;
-        break;
     case 'C':
         if(currentCam == FREE_CAM) {
             currentCam  = lastFixedCam;
@@ -405,7 +460,7 @@ void ofApp::keyPressed(int key) {
         cam.disableMouseInput();
         break;
     case 'r':
-        if (gameOver || gameWin) {
+        if (sim.snapshot().gameOver || sim.snapshot().gameWin) {
             restartGame();
         }
         break;
@@ -418,26 +473,66 @@ void ofApp::keyPressed(int key) {
 	case 'R':
 		cam.reset();
 		break;
+#ifdef LANDER_PROFILE
+	case 'p':
+		bShowProfiler = !bShowProfiler;
+		break;
+	case 'P':
+		if (Profiler::get().exportCsv(ofToDataPath("profile.csv")) &&
+			Profiler::get().exportChromeTrace(ofToDataPath("profile.json"))) {
+			cout << "profile written to profile.csv and profile.json" << endl;
+		}
+		break;
+#endif
+	case 'o':
+		bDisplayOctree = !bDisplayOctree;
+		break;
+	case 'O':
+		bDisplayLeafNodes = !bDisplayLeafNodes;
+		break;
+	case '[':
+		octreeDisplayLevel = std::max(1, octreeDisplayLevel - 1);
+		break;
+	case ']':
+		octreeDisplayLevel++;
+		break;
 	case 's':
 		savePicture();
 		break;
 	case 't':
 		setCameraTarget();
 		break;
+	case 'v':
+		bCullTerrain = !bCullTerrain;
+		break;
+	case 'm':
+		if (bTerrainReady && !bStreamTerrain) runEstimate(2000);
+		break;
+	case 'b':
+		if (!bTerrainReady) break;
+		if (!bStreamTerrain) {
+			benchOctreeDescent(octree, lander.getSceneMin(), lander.getSceneMax(), lander.getPosition(), 600);
+			benchOctreeNearest(octree, 1000, 8, 5.0);
+			benchOctreeBuild(terrainMesh, 20);
+			benchCompactOctree(octree, 2000);
+			benchSpatialIndexes(terrainMesh, 1000);
+			benchStaticOctree(octree, 2000);
+			benchFrustumCull(terrainChunks, 1000);
+		}
+		benchTripleBuffer(200000);
+		benchLooseOctree(20000, 100);
+		benchParticleCollision(heightField, 50000, 100);
+		benchObjLoad("geo/terrain.obj");
+		break;
     case 'w':
 		toggleWireframeMode();
 		break;
     case 'g':
         bShowTelemetry = !bShowTelemetry;
         break;
-	case '1':
-		landingStarted=true;
-		break;
 	default:
 		break;
 	}
-
-	keymap[key] = true;
 }
 
 void ofApp::toggleWireframeMode() {
@@ -449,7 +544,44 @@ void ofApp::toggleSelectTerrain() {
 }
 
 void ofApp::keyReleased(int key) {
-	keymap[key] = false;
+	if (input.mode == InputRecorder::REPLAYING && !bInjectingInput) return;
+	input.record(key, false);
+	sim.key(key, false);
+}
+
+//--------------------------------------------------------------
+// end of a replay: report frame times, octree work and where the lander
+// finished (identical for identical runs), then quit
+//
+void ofApp::finishReplay() {
+	glm::vec3 p = sim.snapshot().landerPos;
+	cout << "replay " << replayPath << ": " << input.numTicks << " ticks" << endl;
+	cout << "  frame " << replayStats.frameSeconds * 1000 / std::max(1, replayStats.frames) << " ms avg, "
+		<< replayStats.worstFrame * 1000 << " ms worst" << endl;
+	cout << "  lander query " << (double)replayStats.nodesVisited / std::max(1, replayStats.frames)
+		<< " nodes/frame" << endl;
+	cout << "  final lander position " << p.x << " " << p.y << " " << p.z << ", fuel " << sim.snapshot().fuel << endl;
+	ofExit(0);
+}
+
+//--------------------------------------------------------------
+// fly "rollouts" autopilot landings from around the lander's start with the
+// simulation's current physics and print the outcome
+//
+void ofApp::runEstimate(int rollouts) {
+	LandingScenario scenario;
+	scenario.params = sim.params;
+	scenario.start = lander.getPosition();
+	scenario.rollouts = rollouts;
+	LandingEstimator::print(scenario, estimator.run(scenario));
+}
+
+void ofApp::exit() {
+	sim.stop();
+	if (input.mode == InputRecorder::RECORDING) {
+		if (input.save(recordPath)) cout << "input recorded to " << recordPath << " (" << input.numTicks << " ticks)" << endl;
+		else cout << "Error: can't write input recording " << recordPath << endl;
+	}
 }
 
 //--------------------------------------------------------------
@@ -466,11 +598,11 @@ void ofApp::mousePressed(int x, int y, int button) {
 		glm::vec3 mouseWorld = cam.screenToWorld(glm::vec3(mouseX, mouseY, 0));
 		glm::vec3 mouseDir = glm::normalize(mouseWorld - origin);
 
-		ofVec3f min = lander.getSceneMin() + lander.getPosition();
-		ofVec3f max = lander.getSceneMax() + lander.getPosition();
+		glm::vec3 min = lander.getSceneMin() + lander.getPosition();
+		glm::vec3 max = lander.getSceneMax() + lander.getPosition();
 
-		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-		bool hit = bounds.intersect(Ray(Vector3(origin.x, origin.y, origin.z), Vector3(mouseDir.x, mouseDir.y, mouseDir.z)), 0, 10000);
+		Box bounds = Box(min, max);
+		bool hit = bounds.intersect(Ray(origin, mouseDir), 0, 10000);
 		if (hit) {
             cam.disableMouseInput();
 			bLanderSelected = true;
@@ -489,19 +621,21 @@ void ofApp::mousePressed(int x, int y, int button) {
 }
 
 bool ofApp::raySelectWithOctree(ofVec3f &pointRet) {
-	ofVec3f mouse(mouseX, mouseY);
-	ofVec3f rayPoint = cam.screenToWorld(mouse);
-	ofVec3f rayDir = rayPoint - cam.getPosition();
-	rayDir.normalize();
-	Ray ray = Ray(Vector3(rayPoint.x, rayPoint.y, rayPoint.z),
-		Vector3(rayDir.x, rayDir.y, rayDir.z));
+	glm::vec3 rayPoint = cam.screenToWorld(glm::vec3(mouseX, mouseY, 0));
+	glm::vec3 rayDir = glm::normalize(rayPoint - cam.getPosition());
+	Ray ray = Ray(rayPoint, rayDir);
 
 	float startTime = ofGetElapsedTimef() * 1000;
-	pointSelected = octree.intersect(ray, octree.root, selectedNode);
-
-	if (pointSelected) {
-		pointRet = octree.mesh.getVertex(selectedNode.points[0]);
+	if (!bTerrainReady) return false;
+	if (bStreamTerrain) {
+		glm::vec3 p;
+		pointSelected = terrainStreamer.intersect(ray, p);
+		if (pointSelected) pointRet = p;
+		return pointSelected;
 	}
+	SpatialHit hit;
+	pointSelected = rayTerrain().raycast(ray, *pickContext, hit);
+	if (pointSelected) pointRet = hit.point;
 	return pointSelected;
 }
 
@@ -521,15 +655,15 @@ void ofApp::mouseDragged(int x, int y, int button) {
 	
 		landerPos += delta;
 		lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
+		sim.moveLander(landerPos);
 		mouseLastPos = mousePos;
 
-		ofVec3f min = lander.getSceneMin() + landerPos;
-		ofVec3f max = lander.getSceneMax() + landerPos;
-
-		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+		Box bounds = Box(lander.getSceneMin() + landerPos, lander.getSceneMax() + landerPos);
 
 		colBoxList.clear();
-		octree.intersect(bounds, octree.root, colBoxList);
+		if (!bTerrainReady) return;
+		if (bStreamTerrain) terrainStreamer.intersect(bounds, colBoxList);
+		else terrainIndex.overlapCells(bounds, *landerContext, colBoxList);
 
 
 	}
@@ -714,7 +848,7 @@ void ofApp::dragEvent(ofDragInfo dragInfo) {
 
 			// set up bounding box for lander while we are at it
 			//
-			landerBounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+			landerBounds = Box(min, max);
 		}
 	}
 
@@ -757,17 +891,8 @@ void ofApp::drawStarfield() {
 }
 
 void ofApp::restartGame() {
-    gameOver = false;
-    gameWin = false;
-    showGameOverText = false;
-    explosionActive = false;
-    shipVelocity = 0;
-    shipVelocityX = 0;
-    shipVelocityZ = 0;
-    fuel = 120.0f;
-    fuelTimer = 0.0f;
-    lander.setPosition(0, 50, 0);
+
+	// the simulation resets itself on the same 'r'
+	//
     lander.setScale(1, 1, 1);
-    shooter->sys->particles.clear();
-    landingStarted = false;
 }
@@ -3,46 +3,26 @@
 #include "ofxGui.h"
 #include  "ofxAssimpModelLoader.h"
 #include "Octree.h"
+#include "SpatialIndex.h"
+#include "Bvh.h"
+#include "HeightField.h"
+#include "TerrainStreamer.h"
+#include "TerrainChunks.h"
+#include "Profiler.h"
+#include "InputRecorder.h"
+#include "Simulation.h"
+#include "LandingEstimator.h"
+#include "TerrainAO.h"
+#include "AsyncLoader.h"
 #include "Emitter.h"
 #include "Shape.h"
 
-inline float RandomFloat(float a, float b) {
-	float random = ((float)rand()) / (float)RAND_MAX;
-	float diff = b - a;
-	float r = random * diff;
-	return a + r;
-}
-
-class Agent : public Particle {
-public:
-	Agent() : Particle() {}
-};
-
-class AgentEmitter : public Emitter {
-public:
-    void spawnSprite(){
-        Agent particle;
-		particle.velocity = velocity;
-		particle.lifespan = lifespan;
-		particle.pos = pos;
-		particle.birthtime = ofGetElapsedTimeMillis();
-		sys->add(particle);
-	}
-    
-	void moveSprite(Particle* particle) {
-		Emitter::moveParticle(particle);
-        glm::vec3 v = glm::normalize(particle->velocity);
-		glm::vec3 u = glm::vec3(0, -1, 0);
-		float a = glm::orientedAngle(u, v, glm::vec3(0, 0, 1));
-		particle->rot = glm::degrees(a);
-	}
-};
-
 class ofApp : public ofBaseApp{
 	public:
 		void setup();
 		void update();
 		void draw();
+		void exit();
 
 		void keyPressed(int key);
 		void keyReleased(int key);
@@ -57,8 +37,14 @@ class ofApp : public ofBaseApp{
 		void toggleWireframeMode();
 		void toggleSelectTerrain();
 		void setCameraTarget();
+		void applySnapshot(const SimSnapshot & state);
+		void loadTerrainAsync();
+		void publishTerrain();
+		void finishReplay();
+		void runEstimate(int rollouts);
 		bool mouseIntersectPlane(ofVec3f planePoint, ofVec3f planeNorm, ofVec3f &point);
 		bool raySelectWithOctree(ofVec3f &pointRet);
+		const SpatialIndex & rayTerrain() const { return bBvhRays ? (const SpatialIndex &)terrainBvh : terrainIndex; }
 		glm::vec3 getMousePointOnPlane(glm::vec3 p , glm::vec3 n);
         void drawStarfield();
         void restartGame();
@@ -68,19 +54,30 @@ class ofApp : public ofBaseApp{
         CamMode lastFixedCam = TRACK_CAM;
 
 		ofEasyCam cam;
-		ofxAssimpModelLoader mars, lander;
+		ofxAssimpModelLoader lander;
+		ofVboMesh terrainMesh;
+		ofMaterial terrainMaterial;
+		const ofFloatColor terrainColor = ofFloatColor(0.72, 0.45, 0.32);
+		TerrainChunks terrainChunks;
+		vector<int> visibleChunks;
+		vector<pair<int, int>> visibleRanges;
         Box boundingBox, landerBounds;
 		Box testBox;
 		vector<Box> colBoxList;
         Octree octree;
-		TreeNode selectedNode;
+        OctreeIndex terrainIndex { octree };	// what the game queries; builds octree
+        Bvh terrainBvh;					// altitude ray and picking with "--bvh"
+        std::unique_ptr<SpatialContext> landerContext, pickContext;	// lander drags and picking, main thread
+        HeightField heightField;
+        LandingMap landingMap;
+        TerrainStreamer terrainStreamer;
 		glm::vec3 mouseDownPos, mouseLastPos;
-        glm::vec3 collisionDirection = glm::vec3(0, 0, 0);
-        glm::vec3 explosionVelocity;
 		        
         ofxPanel gui;
         ofxLabel altitudeLabel;
         ofxLabel fuelLabel;
+        ofxLabel clearanceLabel;
+        ofxLabel siteLabel;
         ofVec3f selectedPoint;
         ofVec3f intersectPoint;
         ofLight keyLight;
@@ -88,48 +85,71 @@ class ofApp : public ofBaseApp{
         ofLight backLight;
         ofLight shipLight;
     
-        bool gameOver = false;
-        bool showGameOverText = false;
         bool bLanderSelected = false;
         bool bInDrag = false;
 		bool bWireframe;
 		bool pointSelected = false;
 		bool bDisplayLeafNodes = false;
 		bool bDisplayOctree = false;
+		int octreeDisplayLevel = 5;
 		bool bDisplayBBoxes = false;
 		bool bLanderLoaded;
 		bool bTerrainSelected;
         bool bShowTelemetry = false;
-        bool explosionActive = false;
-        bool bResolveCollision = false;
-        bool landingStarted = false;
-        bool gameWin = false;
         bool bShipLightOn = false;
+        bool bStreamTerrain = false;
+        bool bTerrainReady = false;		// set on the main thread by publishTerrain()
+        bool bCullTerrain = true;
+        bool bShowProfiler = false;
+        bool bProceduralZones = false;	// landing zones picked from the landing map ("--procedural-zones")
+        bool bBvhRays = false;			// rays against terrain triangles ("--bvh")
 
-		Emitter* shooter = NULL;
-		
 		const float selectionRange = 4.0;
-		float collisionSpeed = 0.1;
-		float shipVelocity = 0.0;
-		float shipAcceleration = 0.0;
-		float shipVelocityX = 0.0;
-		float shipAccelerationX = 0.0;
-		float shipVelocityZ = 0.0;
-		float shipAccelerationZ = 0.0;
-        float fuel = 120.0f;
-        float fuelTimer = 0.0f;
-        float landerRotation = 0.0f;
-        float rotationSpeed = 1.0f;
         float landingZoneSize = 15.0f;
+        int heightFieldResolution = 1024;
+        int terrainChunkDepth = 4;
+        size_t terrainMemoryBudget = 512 * 1024 * 1024;
     
         vector<Box> bboxList;
         vector<ofPoint> stars;
         vector<glm::vec3> landingZones;
 
-		map<int, bool> keymap;
+		// input recording / replay, paths set from the command line in main()
+		//
+		string recordPath;
+		string replayPath;
+		InputRecorder input;
+		vector<InputEvent> tickEvents;
+		bool bInjectingInput = false;
+		struct {
+			int frames = 0;
+			double frameSeconds = 0;
+			double worstFrame = 0;
+			long nodesVisited = 0;
+		} replayStats;
+
+		// landing outcome estimates ('m', or "--estimate <rollouts>" from
+		// the command line, which quits when done)
+		//
+		LandingEstimator estimator;
+		int estimateRollouts = 0;
 
 		ofSoundPlayer   bumpS;
 		ofSoundPlayer   crashS;
 		ofSoundPlayer   shootS;
 		ofSoundPlayer   thrustS;
+
+		// lander physics, collisions and particles; declared after the terrain
+		// it reads, so its thread stops first
+		//
+		Simulation sim;
+
+		// background terrain load; loadingMesh, octree, heightField,
+		// landingMap and terrainChunks belong to its jobs until publishTerrain()
+		//
+		ofMesh loadingMesh;
+		AsyncLoader terrainLoader;
+		int lastCrashes = 0;
+		int lastBumps = 0;
+		int lastFuel = -1;
 };
@@ -2,37 +2,99 @@
 #define _VECTOR3_H_
 
 #include <math.h>
+#include <glm/vec3.hpp>
 
-class Vector3 {
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VECTOR3_SSE2
+#endif
+
+/*
+ * 3 component vector stored in a 16 byte aligned lane of four floats so the
+ * arithmetic, min/max and box slab tests run on whole SSE registers.  The
+ * fourth lane is padding; it starts at 0 and no result depends on it.
+ * Trivially copyable, and converts to and from glm::vec3 implicitly, so mesh
+ * vertices and camera vectors can be passed straight to Box and Ray without
+ * spelling out each component at the call site.
+ */
+
+class alignas(16) Vector3 {
   public:
-    Vector3() { };
-    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; }
-    Vector3(const Vector3 &v)
-      { d[0] = v.d[0]; d[1] = v.d[1]; d[2] = v.d[2]; }
+    Vector3() : d{ 0, 0, 0, 0 } { }
+    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; d[3] = 0; }
+    Vector3(const glm::vec3 &v) { d[0] = v.x; d[1] = v.y; d[2] = v.z; d[3] = 0; }
+    operator glm::vec3() const { return glm::vec3(d[0], d[1], d[2]); }
 
     float x() const { return d[0]; }
     float y() const { return d[1]; }
     float z() const { return d[2]; }
 
     float operator[](int i) const { return d[i]; }
-    
+
     float length() const
-      { return sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]); }
+      { return sqrt(*this * *this); }
     void normalize() {
       float temp = length();
       if (temp == 0.0)
         return;	// 0 length vector
       // multiply by 1/magnitude
-      temp = 1 / temp;
-      d[0] *= temp;
-      d[1] *= temp;
-      d[2] *= temp;
+      *this *= 1 / temp;
+    }
+
+#ifdef VECTOR3_SSE2
+    explicit Vector3(__m128 m) { _mm_store_ps(d, m); }
+    __m128 simd() const { return _mm_load_ps(d); }
+
+    static Vector3 min(const Vector3 &a, const Vector3 &b)
+      { return Vector3(_mm_min_ps(a.simd(), b.simd())); }
+    static Vector3 max(const Vector3 &a, const Vector3 &b)
+      { return Vector3(_mm_max_ps(a.simd(), b.simd())); }
+
+    /////////////////////////////////////////////////////////
+    // Overloaded operators
+    /////////////////////////////////////////////////////////
+
+    Vector3 operator+(const Vector3 &op2) const {   // vector addition
+      return Vector3(_mm_add_ps(simd(), op2.simd()));
+    }
+    Vector3 operator-(const Vector3 &op2) const {   // vector subtraction
+      return Vector3(_mm_sub_ps(simd(), op2.simd()));
+    }
+    Vector3 operator-() const {                    // unary minus
+      return Vector3(_mm_sub_ps(_mm_setzero_ps(), simd()));
+    }
+    Vector3 operator*(float s) const {            // scalar multiplication
+      return Vector3(_mm_mul_ps(simd(), _mm_set1_ps(s)));
+    }
+    void operator*=(float s) {
+      _mm_store_ps(d, _mm_mul_ps(simd(), _mm_set1_ps(s)));
+    }
+    float operator*(const Vector3 &op2) const {   // dot product
+      __m128 m = _mm_mul_ps(simd(), op2.simd());
+      __m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+      __m128 z = _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2));
+      return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+    }
+    Vector3 operator^(const Vector3 &op2) const {   // cross product
+      __m128 a = simd(), b = op2.simd();
+      __m128 ayzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+      __m128 bzxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+      __m128 azxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+      __m128 byzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+      return Vector3(_mm_sub_ps(_mm_mul_ps(ayzx, bzxy), _mm_mul_ps(azxy, byzx)));
+    }
+#else
+    static Vector3 min(const Vector3 &a, const Vector3 &b) {
+      return Vector3(fminf(a.d[0], b.d[0]), fminf(a.d[1], b.d[1]), fminf(a.d[2], b.d[2]));
+    }
+    static Vector3 max(const Vector3 &a, const Vector3 &b) {
+      return Vector3(fmaxf(a.d[0], b.d[0]), fmaxf(a.d[1], b.d[1]), fmaxf(a.d[2], b.d[2]));
     }
 
     /////////////////////////////////////////////////////////
     // Overloaded operators
     /////////////////////////////////////////////////////////
-  
+
     Vector3 operator+(const Vector3 &op2) const {   // vector addition
       return Vector3(d[0] + op2.d[0], d[1] + op2.d[1], d[2] + op2.d[2]);
     }
@@ -50,9 +112,6 @@ class Vector3 {
       d[1] *= s;
       d[2] *= s;
     }
-    Vector3 operator/(float s) const {            // scalar division
-      return Vector3(d[0] / s, d[1] / s, d[2] / s);
-    }
     float operator*(const Vector3 &op2) const {   // dot product
       return d[0] * op2.d[0] + d[1] * op2.d[1] + d[2] * op2.d[2];
     }
@@ -60,6 +119,10 @@ class Vector3 {
       return Vector3(d[1] * op2.d[2] - d[2] * op2.d[1], d[2] * op2.d[0] - d[0] * op2.d[2],
                     d[0] * op2.d[1] - d[1] * op2.d[0]);
     }
+#endif
+    Vector3 operator/(float s) const {            // scalar division
+      return Vector3(d[0] / s, d[1] / s, d[2] / s);
+    }
     bool operator==(const Vector3 &op2) const {
       return (d[0] == op2.d[0] && d[1] == op2.d[1] && d[2] == op2.d[2]);
     }
@@ -72,9 +135,9 @@ class Vector3 {
     bool operator<=(const Vector3 &op2) const {
       return (d[0] <= op2.d[0] && d[1] <= op2.d[1] && d[2] <= op2.d[2]);
     }
-  
+
   private:
-    float d[3];
+    float d[4];
 };
 
 #endif // _VECTOR3_H_